@@ -8,3 +8,6 @@
 #include "salalib/latticemap.hpp"
 #include "salalib/shapegraph.hpp"
 #include "salalib/shapemap.hpp"
+
+#include "engine_latticeGraph.hpp"
+#include "process_isovist.hpp"
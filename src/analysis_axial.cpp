@@ -10,6 +10,7 @@
 #include "salalib/shapemap.hpp"
 
 #include "communicator.hpp"
+#include "engine_axialTraversal.hpp"
 #include "enum_TraversalType.hpp"
 #include "helper_enum.hpp"
 #include "helper_nullablevalue.hpp"
@@ -17,6 +18,8 @@
 
 #include <Rcpp.h>
 
+// [[Rcpp::plugins(openmp)]]
+
 // [[Rcpp::export("Rcpp_runAxialAnalysis")]]
 Rcpp::List runAxialAnalysis(Rcpp::XPtr<ShapeGraph> mapPtr, const Rcpp::NumericVector radii,
                             const Rcpp::Nullable<std::string> weightedMeasureColNameNV = R_NilValue,
@@ -24,7 +27,8 @@ Rcpp::List runAxialAnalysis(Rcpp::XPtr<ShapeGraph> mapPtr, const Rcpp::NumericVe
                             const Rcpp::Nullable<bool> includeIntermediateMetricsNV = R_NilValue,
                             const Rcpp::Nullable<bool> copyMapNV = R_NilValue,
                             const Rcpp::Nullable<bool> verboseNV = R_NilValue,
-                            const Rcpp::Nullable<bool> progressNV = R_NilValue) {
+                            const Rcpp::Nullable<bool> progressNV = R_NilValue,
+                            const Rcpp::Nullable<int> nthreadsNV = R_NilValue) {
 
     auto weightedMeasureColName = NullableValue::getOptional(weightedMeasureColNameNV);
     auto includeChoice = NullableValue::get(includeChoiceNV, false);
@@ -37,12 +41,18 @@ Rcpp::List runAxialAnalysis(Rcpp::XPtr<ShapeGraph> mapPtr, const Rcpp::NumericVe
     auto copyMap = NullableValue::get(copyMapNV, true);
     auto verbose = NullableValue::get(verboseNV, false);
     auto progress = NullableValue::get(progressNV, false);
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
 
     mapPtr = RcppRunner::copyMap(mapPtr, copyMap);
 
     return RcppRunner::runAnalysis<ShapeGraph>(
         mapPtr, progress,
-        [&radii, &weightedMeasureColName, &includeChoice, &includeIntermediateMetrics,
+        [&radii, &weightedMeasureColName, &includeChoice, &includeIntermediateMetrics, &nthreads,
          &verbose](Communicator *comm, Rcpp::XPtr<ShapeGraph> mapPtr) {
             if (verbose)
                 Rcpp::Rcout << "Running axial analysis... " << '\n';
@@ -65,6 +75,17 @@ Rcpp::List runAxialAnalysis(Rcpp::XPtr<ShapeGraph> mapPtr, const Rcpp::NumericVe
 
             std::set<double> radius_set;
             radius_set.insert(radii.begin(), radii.end());
+
+            if (nthreads != 1) {
+                // the sala analysis is single-threaded, split the origins
+                // between threads instead. The batched traversal (without
+                // choice) is only used here, so that a single thread always
+                // gives sala's own results
+                return AxialTraversal::runIntegration(comm, *mapPtr, radius_set,
+                                                      weightedMeasureColIdx, includeChoice,
+                                                      includeIntermediateMetrics, nthreads);
+            }
+
             auto analysis = AxialIntegration(radius_set, weightedMeasureColIdx, includeChoice,
                                              includeIntermediateMetrics);
             AnalysisResult analysisResult = analysis.run(comm, *mapPtr, false /* simple version*/);
@@ -116,6 +137,16 @@ Rcpp::List axialStepDepth(Rcpp::XPtr<ShapeGraph> mapPtr, const int stepType,
             if (verbose)
                 Rcpp::Rcout << "ok\nSelecting cells... " << '\n';
 
+            if (traversalStepType == TraversalType::Metric) {
+                // not available in sala, the origins are taken as one group
+                std::vector<std::vector<Point2f>> groupPoints(1);
+                for (size_t i = 0; i < stepDepthPointsX.size(); ++i) {
+                    groupPoints[0].emplace_back(stepDepthPointsX[i], stepDepthPointsY[i]);
+                }
+                return AxialTraversal::runStepDepth(comm, *mapPtr, traversalStepType, groupPoints,
+                                                    {}, 1);
+            }
+
             std::set<int> origins;
             for (size_t i = 0; i < stepDepthPointsX.size(); ++i) {
                 Point2f p2f(stepDepthPointsX[i], stepDepthPointsY[i]);
@@ -141,7 +172,8 @@ Rcpp::List axialStepDepth(Rcpp::XPtr<ShapeGraph> mapPtr, const int stepType,
                 break;
             case TraversalType::Angular:
             case TraversalType::Metric:
-                // never really supported for axial maps
+                // angular never really supported for axial maps, metric
+                // handled above
                 throw genlib::RuntimeException("Error, unsupported step type");
             case TraversalType::None: {
                 throw genlib::RuntimeException("Error, unsupported step type");
@@ -150,3 +182,59 @@ Rcpp::List axialStepDepth(Rcpp::XPtr<ShapeGraph> mapPtr, const int stepType,
             return analysisResult;
         });
 }
+
+// [[Rcpp::export("Rcpp_axialStepDepthGroups")]]
+Rcpp::List axialStepDepthGroups(Rcpp::XPtr<ShapeGraph> mapPtr, const int stepType,
+                                const std::vector<double> stepDepthPointsX,
+                                const std::vector<double> stepDepthPointsY,
+                                const std::vector<int> originGroupIdxs,
+                                const std::vector<std::string> groupNames,
+                                const Rcpp::Nullable<int> nthreadsNV = R_NilValue,
+                                const Rcpp::Nullable<bool> copyMapNV = R_NilValue,
+                                const Rcpp::Nullable<bool> verboseNV = R_NilValue,
+                                const Rcpp::Nullable<bool> progressNV = R_NilValue) {
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+    auto copyMap = NullableValue::get(copyMapNV, true);
+    auto verbose = NullableValue::get(verboseNV, false);
+    auto progress = NullableValue::get(progressNV, false);
+
+    auto traversalStepType = getAsValidEnum<TraversalType>(stepType);
+
+    if (stepDepthPointsX.size() != stepDepthPointsY.size() ||
+        stepDepthPointsX.size() != originGroupIdxs.size()) {
+        Rcpp::stop("Different number of origin coordinates and origin groups provided");
+    }
+    if (traversalStepType != TraversalType::Topological &&
+        traversalStepType != TraversalType::Metric) {
+        Rcpp::stop("Only topological and metric depth are available for axial maps");
+    }
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
+
+    mapPtr = RcppRunner::copyMap(mapPtr, copyMap);
+
+    return RcppRunner::runAnalysis<ShapeGraph>(
+        mapPtr, progress,
+        [&traversalStepType, &stepDepthPointsX, &stepDepthPointsY, &originGroupIdxs, &groupNames,
+         &nthreads, &verbose](Communicator *comm, Rcpp::XPtr<ShapeGraph> mapPtr) {
+            // R group indices start from 1
+            std::vector<std::vector<Point2f>> groupPoints(groupNames.size());
+            for (size_t i = 0; i < stepDepthPointsX.size(); ++i) {
+                if (originGroupIdxs[i] < 1 ||
+                    originGroupIdxs[i] > static_cast<int>(groupNames.size())) {
+                    Rcpp::stop("Origin group index %d out of range", originGroupIdxs[i]);
+                }
+                groupPoints[originGroupIdxs[i] - 1].emplace_back(stepDepthPointsX[i],
+                                                                 stepDepthPointsY[i]);
+            }
+
+            if (verbose) {
+                Rcpp::Rcout << "Calculating step-depth... " << '\n';
+            }
+
+            return AxialTraversal::runStepDepth(comm, *mapPtr, traversalStepType, groupPoints,
+                                                groupNames, nthreads);
+        });
+}
@@ -10,13 +10,18 @@
 #include "salalib/segmmodules/segmtulipdepth.hpp"
 
 #include "communicator.hpp"
+#include "engine_segmentDepth.hpp"
+#include "engine_segmentFullAngular.hpp"
 #include "enum_TraversalType.hpp"
 #include "helper_enum.hpp"
 #include "helper_nullablevalue.hpp"
+#include "helper_parallel.hpp"
 #include "helper_runAnalysis.hpp"
 
 #include <Rcpp.h>
 
+// [[Rcpp::plugins(openmp)]]
+
 // [[Rcpp::export("Rcpp_segmentStepDepth")]]
 Rcpp::List segmentStepDepth(Rcpp::XPtr<ShapeGraph> mapPtr, const int stepType,
                             const std::vector<double> stepDepthPointsX,
@@ -64,10 +69,9 @@ Rcpp::List segmentStepDepth(Rcpp::XPtr<ShapeGraph> mapPtr, const int stepType,
                                          .run(comm, *mapPtr, false /* simple mode */
                                          );
                 } else {
-                    // full angular was never created as a step-function
-                    // do normal tulip
-                    Rcpp::stop("Full angular depth not implemented, "
-                               "provide tulipBins for quantization");
+                    // full angular was never created as a step-function in
+                    // sala, use the non-quantised engine
+                    analysisResult = FullAngular::runStepDepth(comm, *mapPtr, origins);
                 }
                 break;
             case TraversalType::Metric: {
@@ -88,3 +92,81 @@ Rcpp::List segmentStepDepth(Rcpp::XPtr<ShapeGraph> mapPtr, const int stepType,
             return analysisResult;
         });
 }
+
+// [[Rcpp::export("Rcpp_segmentStepDepthGroups")]]
+Rcpp::List segmentStepDepthGroups(Rcpp::XPtr<ShapeGraph> mapPtr, const int stepType,
+                                  const std::vector<double> stepDepthPointsX,
+                                  const std::vector<double> stepDepthPointsY,
+                                  const std::vector<int> originGroupIdxs,
+                                  const std::vector<std::string> groupNames,
+                                  const Rcpp::Nullable<int> tulipBinsNV = R_NilValue,
+                                  const Rcpp::Nullable<int> nthreadsNV = R_NilValue,
+                                  const Rcpp::Nullable<bool> copyMapNV = R_NilValue,
+                                  const Rcpp::Nullable<bool> verboseNV = R_NilValue,
+                                  const Rcpp::Nullable<bool> progressNV = R_NilValue) {
+    auto tulipBins = NullableValue::get(tulipBinsNV, 0);
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+    auto copyMap = NullableValue::get(copyMapNV, true);
+    auto verbose = NullableValue::get(verboseNV, false);
+    auto progress = NullableValue::get(progressNV, false);
+
+    auto traversalStepType = getAsValidEnum<TraversalType>(stepType);
+
+    if (stepDepthPointsX.size() != stepDepthPointsY.size() ||
+        stepDepthPointsX.size() != originGroupIdxs.size()) {
+        Rcpp::stop("Different number of origin coordinates and origin groups provided");
+    }
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
+
+    mapPtr = RcppRunner::copyMap(mapPtr, copyMap);
+
+    return RcppRunner::runAnalysis<ShapeGraph>(
+        mapPtr, progress,
+        [&traversalStepType, &stepDepthPointsX, &stepDepthPointsY, &originGroupIdxs, &groupNames,
+         &tulipBins, &nthreads, &verbose](Communicator *comm, Rcpp::XPtr<ShapeGraph> mapPtr) {
+            if (verbose) {
+                Rcpp::Rcout << "ok\nSelecting cells... " << '\n';
+            }
+
+            // R group indices start from 1
+            std::vector<std::set<int>> groupOrigins(groupNames.size());
+            auto graphRegion = mapPtr->getRegion();
+            for (size_t i = 0; i < stepDepthPointsX.size(); ++i) {
+                if (originGroupIdxs[i] < 1 ||
+                    originGroupIdxs[i] > static_cast<int>(groupNames.size())) {
+                    Rcpp::stop("Origin group index %d out of range", originGroupIdxs[i]);
+                }
+                Point2f p2f(stepDepthPointsX[i], stepDepthPointsY[i]);
+                if (!graphRegion.contains(p2f)) {
+                    Rcpp::stop("Point outside of target region");
+                }
+                Region4f r(p2f, p2f);
+                auto shapesInRegion = mapPtr->getShapesInRegion(r);
+                if (shapesInRegion.empty()) {
+                    Rcpp::stop("Point (%f %f) does not touch any segment", p2f.x, p2f.y);
+                }
+                groupOrigins[originGroupIdxs[i] - 1].insert(shapesInRegion.begin()->first);
+            }
+
+            if (verbose) {
+                Rcpp::Rcout << "ok\nCalculating step-depth... " << '\n';
+            }
+
+            auto groupColumns = SegmentDepth::runStepDepthGroups(
+                comm, *mapPtr, traversalStepType, tulipBins, groupOrigins, nthreads);
+
+            AnalysisResult analysisResult;
+            analysisResult.completed = true;
+            for (const auto &columns : groupColumns) {
+                analysisResult.completed = analysisResult.completed && columns.completed;
+            }
+            for (const auto &column :
+                 Parallel::writeGroupColumns(mapPtr->getAttributeTable(), groupColumns, groupNames)) {
+                analysisResult.addAttribute(column);
+            }
+            return analysisResult;
+        });
+}
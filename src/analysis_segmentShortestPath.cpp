@@ -10,6 +10,7 @@
 #include "salalib/segmmodules/segmtulipshortestpath.hpp"
 
 #include "communicator.hpp"
+#include "engine_segmentFullAngular.hpp"
 #include "enum_TraversalType.hpp"
 #include "helper_enum.hpp"
 #include "helper_nullablevalue.hpp"
@@ -17,17 +18,26 @@
 
 #include <Rcpp.h>
 
+// [[Rcpp::plugins(openmp)]]
+
 // [[Rcpp::export("Rcpp_segmentShortestPath")]]
 Rcpp::List segmentShortestPath(Rcpp::XPtr<ShapeGraph> mapPtr, const int stepType,
                                Rcpp::NumericMatrix origPoints, Rcpp::NumericMatrix destPoints,
                                const Rcpp::Nullable<int> tulipBinsNV = R_NilValue,
                                const Rcpp::Nullable<bool> copyMapNV = R_NilValue,
                                const Rcpp::Nullable<bool> verboseNV = R_NilValue,
-                               const Rcpp::Nullable<bool> progressNV = R_NilValue) {
+                               const Rcpp::Nullable<bool> progressNV = R_NilValue,
+                               const Rcpp::Nullable<int> nthreadsNV = R_NilValue) {
     auto tulipBins = NullableValue::get(tulipBinsNV, 0);
     auto copyMap = NullableValue::get(copyMapNV, true);
     auto verbose = NullableValue::get(verboseNV, false);
     auto progress = NullableValue::get(progressNV, false);
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
 
     if (origPoints.rows() != destPoints.rows()) {
         Rcpp::stop("Different number of origins and destinations provided (%d %d).",
@@ -40,12 +50,39 @@ Rcpp::List segmentShortestPath(Rcpp::XPtr<ShapeGraph> mapPtr, const int stepType
 
     return RcppRunner::runAnalysis<ShapeGraph>(
         mapPtr, progress,
-        [&traversalStepType, &origPoints, &destPoints, &tulipBins,
+        [&traversalStepType, &origPoints, &destPoints, &tulipBins, &nthreads,
          &verbose](Communicator *comm, Rcpp::XPtr<ShapeGraph> mapPtr) {
             if (verbose) {
                 Rcpp::Rcout << "ok\nSelecting cells... " << '\n';
             }
 
+            if (traversalStepType == TraversalType::Angular && tulipBins == 0) {
+                // full angular was never created as a step-function in sala,
+                // use the non-quantised engine, which runs all the pairs (kept
+                // in the order given) in parallel
+                auto graphRegion = mapPtr->getRegion();
+                auto getRef = [&](const Rcpp::NumericMatrix::Row &coordRow) {
+                    Point2f p(coordRow[0], coordRow[1]);
+                    if (!graphRegion.contains(p)) {
+                        Rcpp::stop("Point outside of target region");
+                    }
+                    Region4f region(p, p);
+                    auto shapesInRegion = mapPtr->getShapesInRegion(region);
+                    if (shapesInRegion.empty()) {
+                        Rcpp::stop("Point (%f %f) does not touch any segment", p.x, p.y);
+                    }
+                    return shapesInRegion.begin()->first;
+                };
+                std::vector<std::pair<int, int>> odPairs;
+                for (int r = 0; r < origPoints.rows(); ++r) {
+                    odPairs.emplace_back(getRef(origPoints.row(r)), getRef(destPoints.row(r)));
+                }
+                if (verbose) {
+                    Rcpp::Rcout << "ok\nCalculating shortest-paths.. " << '\n';
+                }
+                return FullAngular::runShortestPaths(comm, *mapPtr, odPairs, nthreads);
+            }
+
             std::set<int> origins;
             for (int r = 0; r < origPoints.rows(); ++r) {
                 auto coordRow = origPoints.row(r);
@@ -79,16 +116,8 @@ Rcpp::List segmentShortestPath(Rcpp::XPtr<ShapeGraph> mapPtr, const int stepType
             for (auto &origin : origins) {
                 switch (traversalStepType) {
                 case TraversalType::Angular:
-                    if (tulipBins != 0) {
-                        analysisResult.append(
-                            SegmentTulipShortestPath(*mapPtr, tulipBins, origin, *destIt)
-                                .run(comm));
-                    } else {
-                        // full angular was never created as a step-function
-                        // do normal tulip
-                        Rcpp::stop("Full angular depth not implemented, "
-                                   "provide tulipBins for quantization");
-                    }
+                    analysisResult.append(
+                        SegmentTulipShortestPath(*mapPtr, tulipBins, origin, *destIt).run(comm));
                     break;
                 case TraversalType::Metric: {
                     analysisResult.append(
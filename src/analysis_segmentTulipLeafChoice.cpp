@@ -8,13 +8,59 @@
 #include "salalib/segmmodules/segmtulipleafchoice.hpp"
 
 #include "communicator.hpp"
+#include "engine_segmentLeafChoice.hpp"
 #include "enum_TraversalType.hpp"
 #include "helper_enum.hpp"
 #include "helper_nullablevalue.hpp"
+#include "helper_parallel.hpp"
 #include "helper_runAnalysis.hpp"
 
 #include <Rcpp.h>
 
+// [[Rcpp::plugins(openmp)]]
+
+namespace { // anonymous
+
+    // Leaf choice is accumulated over all origins, so the origins are split
+    // between threads that share the graph and only keep their own totals
+    // (see engine_segmentLeafChoice). The columns are then made by sala with
+    // no origins, one radius at a time, so that they get the same names as
+    // when the analysis runs through sala, and filled with the totals once
+    AnalysisResult runParallelTulipLeafChoice(Communicator *comm, ShapeGraph &map, int nthreads,
+                                              const std::set<double> &radiusSet, int tulipBins,
+                                              int weightedMeasureColIdx, RadiusType radiusType) {
+        const FullAngular::SegmentGraph graph(map);
+        const auto radii = SegmentLeafChoice::getRadii(radiusSet);
+        const auto totals = SegmentLeafChoice::run(comm, map, graph, radii, tulipBins,
+                                                   weightedMeasureColIdx, radiusType, nthreads);
+
+        AttributeTable &table = map.getAttributeTable();
+        AnalysisResult analysisResult;
+        analysisResult.completed = true;
+        for (size_t r = 0; r < radii.size(); ++r) {
+            auto radiusResult = SegmentTulipLeafChoice({radii[r]}, std::set<int>(), tulipBins,
+                                                       weightedMeasureColIdx, radiusType)
+                                    .run(nullptr, map, false /* interactive */);
+            analysisResult.completed = analysisResult.completed && radiusResult.completed;
+            for (const auto &colName : radiusResult.getAttributes()) {
+                const auto &values = colName.find(" Wgt]") != std::string::npos
+                                         ? totals.weightedChoice[r]
+                                     : colName.find("Leaf Choice") != std::string::npos
+                                         ? totals.choice[r]
+                                         : totals.leaves[r];
+                size_t colIdx = table.getColumnIndex(colName);
+                for (size_t segmentIdx = 0; segmentIdx < values.size(); ++segmentIdx) {
+                    table.getRow(AttributeKey(graph.getRef(segmentIdx)))
+                        .setValue(colIdx, static_cast<float>(values[segmentIdx]));
+                }
+                analysisResult.addAttribute(colName);
+            }
+        }
+        return analysisResult;
+    }
+
+} // namespace
+
 // [[Rcpp::export("Rcpp_runSegmentTulipLeafChoice")]]
 Rcpp::List
 runSegmentTulipLeafChoice(Rcpp::XPtr<ShapeGraph> mapPtr, const Rcpp::NumericVector radii,
@@ -24,7 +70,8 @@ runSegmentTulipLeafChoice(Rcpp::XPtr<ShapeGraph> mapPtr, const Rcpp::NumericVect
                           const Rcpp::Nullable<bool> selOnlyNV = R_NilValue,
                           const Rcpp::Nullable<bool> copyMapNV = R_NilValue,
                           const Rcpp::Nullable<bool> verboseNV = R_NilValue,
-                          const Rcpp::Nullable<bool> progressNV = R_NilValue) {
+                          const Rcpp::Nullable<bool> progressNV = R_NilValue,
+                          const Rcpp::Nullable<int> nthreadsNV = R_NilValue) {
 
     auto weightedMeasureColName = NullableValue::getOptional(weightedMeasureColNameNV);
     auto tulipBins = NullableValue::get(tulipBinsNV, 0);
@@ -34,6 +81,12 @@ runSegmentTulipLeafChoice(Rcpp::XPtr<ShapeGraph> mapPtr, const Rcpp::NumericVect
     auto copyMap = NullableValue::get(copyMapNV, true);
     auto verbose = NullableValue::get(verboseNV, false);
     auto progress = NullableValue::get(progressNV, false);
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
 
     auto radiusTraversalType = getAsValidEnum<TraversalType>(radiusStepType);
 
@@ -41,7 +94,7 @@ runSegmentTulipLeafChoice(Rcpp::XPtr<ShapeGraph> mapPtr, const Rcpp::NumericVect
 
     return RcppRunner::runAnalysis<ShapeGraph>(
         mapPtr, progress,
-        [&radii, &radiusTraversalType, &weightedMeasureColName, &tulipBins,
+        [&radii, &radiusTraversalType, &weightedMeasureColName, &tulipBins, &nthreads,
          &verbose](Communicator *comm, Rcpp::XPtr<ShapeGraph> mapPtr) {
             if (verbose) {
                 Rcpp::Rcout << "Running segment analysis... " << '\n';
@@ -103,12 +156,17 @@ runSegmentTulipLeafChoice(Rcpp::XPtr<ShapeGraph> mapPtr, const Rcpp::NumericVect
             }
 
             AnalysisResult analysisResult;
-            if (tulipBins > 0) {
+            if (tulipBins <= 0) {
+                Rcpp::stop("Tulip bins can not be 0");
+            }
+            if (nthreads == 1) {
                 analysisResult = SegmentTulipLeafChoice(radius_set, std::nullopt, tulipBins,
                                                         weightedMeasureColIdx, radiusType)
                                      .run(comm, *mapPtr, false /* interactive */);
             } else {
-                Rcpp::stop("Tulip bins can not be 0");
+                analysisResult =
+                    runParallelTulipLeafChoice(comm, *mapPtr, nthreads, radius_set, tulipBins,
+                                               weightedMeasureColIdx, radiusType);
             }
             if (verbose) {
                 Rcpp::Rcout << "ok" << '\n';
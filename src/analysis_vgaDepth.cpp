@@ -7,6 +7,7 @@
 #include "salalib/vgamodules/vgametricdepth.hpp"
 #include "salalib/vgamodules/vgavisualglobaldepth.hpp"
 
+#include "engine_latticeGraph.hpp"
 #include "helper_nullablevalue.hpp"
 #include "helper_runAnalysis.hpp"
 
@@ -49,6 +50,39 @@ Rcpp::List vgaVisualDepth(Rcpp::XPtr<LatticeMap> mapPtr, Rcpp::NumericMatrix ste
         });
 }
 
+// [[Rcpp::export("Rcpp_VGA_visualDepthCompressed")]]
+Rcpp::List vgaVisualDepthCompressed(Rcpp::XPtr<LatticeMap> mapPtr,
+                                    Rcpp::XPtr<LatticeGraph::CompressedGraph> graphPtr,
+                                    Rcpp::NumericMatrix stepDepthPoints,
+                                    const Rcpp::Nullable<bool> copyMapNV = R_NilValue,
+                                    const Rcpp::Nullable<bool> progressNV = R_NilValue) {
+    auto copyMap = NullableValue::get(copyMapNV, true);
+    auto progress = NullableValue::get(progressNV, false);
+
+    mapPtr = RcppRunner::copyMapWithRegion(mapPtr, copyMap);
+
+    return RcppRunner::runAnalysis<LatticeMap>(
+        mapPtr, progress,
+        [&stepDepthPoints, &graphPtr](Communicator *comm, Rcpp::XPtr<LatticeMap> mapPtr) {
+            std::set<PixelRef> origins;
+            for (int r = 0; r < stepDepthPoints.rows(); ++r) {
+                auto coordRow = stepDepthPoints.row(r);
+                Point2f p(coordRow[0], coordRow[1]);
+                auto pixref = mapPtr->pixelate(p);
+                if (!mapPtr->includes(pixref)) {
+                    Rcpp::stop("Origin point (%d %d) outside of target lattice map region.", p.x,
+                               p.y);
+                }
+                if (!mapPtr->getPoint(pixref).filled()) {
+                    Rcpp::stop("Origin point (%d %d) not pointing to a filled cell.", p.x, p.y);
+                }
+                origins.insert(pixref);
+            }
+
+            return LatticeGraph::runVisualDepth(comm, *mapPtr, *graphPtr, origins);
+        });
+}
+
 // [[Rcpp::export("Rcpp_VGA_metricDepth")]]
 Rcpp::List vgaMetricDepth(Rcpp::XPtr<LatticeMap> mapPtr, Rcpp::NumericMatrix stepDepthPoints,
                           const Rcpp::Nullable<bool> copyMapNV = R_NilValue,
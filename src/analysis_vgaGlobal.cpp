@@ -10,6 +10,7 @@
 #include "salalib/vgamodules/vgavisualglobal.hpp"
 #include "salalib/vgamodules/vgavisualglobalopenmp.hpp"
 
+#include "engine_latticeMultiResolution.hpp"
 #include "helper_nullablevalue.hpp"
 #include "helper_runAnalysis.hpp"
 
@@ -140,3 +141,30 @@ Rcpp::List vgaVisualGlobal(Rcpp::XPtr<LatticeMap> mapPtr, int radius,
             return analysisResult;
         });
 }
+
+// [[Rcpp::export("Rcpp_VGA_visualGlobalMultiResolution")]]
+Rcpp::List vgaVisualGlobalMultiResolution(Rcpp::XPtr<LatticeMap> mapPtr, int maxBlockLevel,
+                                          const Rcpp::Nullable<int> nthreadsNV = R_NilValue,
+                                          const Rcpp::Nullable<bool> copyMapNV = R_NilValue,
+                                          const Rcpp::Nullable<bool> progressNV = R_NilValue) {
+    if (maxBlockLevel < 0 || maxBlockLevel > 8) {
+        Rcpp::stop("The level of the largest blocks must be an integer between 0 and 8 "
+                   "inclusive. Got %i",
+                   maxBlockLevel);
+    }
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
+    auto copyMap = NullableValue::get(copyMapNV, true);
+    auto progress = NullableValue::get(progressNV, false);
+
+    mapPtr = RcppRunner::copyMapWithRegion(mapPtr, copyMap);
+
+    return RcppRunner::runAnalysis<LatticeMap>(
+        mapPtr, progress,
+        [&nthreads, &maxBlockLevel](Communicator *comm, Rcpp::XPtr<LatticeMap> mapPtr) {
+            return LatticeMultiResolution::runVisualGlobal(comm, *mapPtr, maxBlockLevel, nthreads);
+        });
+}
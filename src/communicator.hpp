@@ -10,6 +10,7 @@
 
 #include <cli/progress.h>
 
+#include <atomic>
 #include <memory>
 
 class ProgressCommunicator : public Communicator {
@@ -45,4 +46,43 @@ class ProgressCommunicator : public Communicator {
     void logInfo(const std::string &message) const override { Rprintf("%s\n", message.c_str()); }
 };
 
+// Communicator handed to each thread of a parallel analysis. Only the thread
+// that runs on the R main thread is given the main communicator to forward
+// messages to, as the R API may not be called from any other thread. All
+// threads share a flag through which cancellation (from the user or from an
+// error in another thread) is propagated.
+class ThreadCommunicator : public Communicator {
+    const Communicator *m_mainComm;
+    std::atomic<bool> &m_cancelFlag;
+
+  public:
+    ThreadCommunicator(const Communicator *mainComm, std::atomic<bool> &cancelFlag)
+        : m_mainComm(mainComm), m_cancelFlag(cancelFlag) {}
+
+    void CommPostMessage(size_t m, size_t x) const override {
+        if (m_mainComm) {
+            m_mainComm->CommPostMessage(m, x);
+            if (m_mainComm->IsCancelled()) {
+                m_cancelFlag = true;
+            }
+        }
+        if (m_cancelFlag) {
+            m_cancelled = true;
+        }
+    }
+
+    void logError(const std::string &message) const override {
+        if (m_mainComm)
+            m_mainComm->logError(message);
+    }
+    void logWarning(const std::string &message) const override {
+        if (m_mainComm)
+            m_mainComm->logWarning(message);
+    }
+    void logInfo(const std::string &message) const override {
+        if (m_mainComm)
+            m_mainComm->logInfo(message);
+    }
+};
+
 std::unique_ptr<Communicator> getCommunicator(const bool printProgress);
@@ -0,0 +1,205 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_axialConversion.hpp"
+
+#include "engine_segmentGrid.hpp"
+#include "helper_parallel.hpp"
+
+#include <Rcpp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace AxialConversion {
+
+    namespace {
+        // tolerance of line intersections, relative to the size of the map,
+        // as in sala
+        constexpr double RELATIVE_TOLERANCE = 1e-9;
+
+        using SegmentIndex::Segment;
+
+        // Whether the two segments cross or touch. A point is taken to be on
+        // a line if it is within the tolerance from it
+        bool segmentsConnect(const Segment &a, const Segment &b, double tolerance) {
+            if (std::min(a[0], a[2]) > std::max(b[0], b[2]) + tolerance ||
+                std::min(b[0], b[2]) > std::max(a[0], a[2]) + tolerance ||
+                std::min(a[1], a[3]) > std::max(b[1], b[3]) + tolerance ||
+                std::min(b[1], b[3]) > std::max(a[1], a[3]) + tolerance) {
+                return false;
+            }
+            // -1 or 1 for the side of the (infinite) line the point is on, 0
+            // if it is on the line
+            auto side = [tolerance](const Segment &s, double px, double py) {
+                double dx = s[2] - s[0], dy = s[3] - s[1];
+                double length = std::hypot(dx, dy);
+                if (length == 0) {
+                    return 0;
+                }
+                double distance = (dx * (py - s[1]) - dy * (px - s[0])) / length;
+                return distance > tolerance ? 1 : (distance < -tolerance ? -1 : 0);
+            };
+            int aStart = side(b, a[0], a[1]), aEnd = side(b, a[2], a[3]);
+            if (aStart != 0 && aStart == aEnd) {
+                return false;
+            }
+            int bStart = side(a, b[0], b[1]), bEnd = side(a, b[2], b[3]);
+            if (bStart != 0 && bStart == bEnd) {
+                return false;
+            }
+            return true;
+        }
+    } // namespace
+
+    std::vector<std::vector<int>> findLineConnections(Communicator *comm,
+                                                      const std::vector<Line4f> &lines,
+                                                      double tolerance, int nthreads) {
+        const size_t numLines = lines.size();
+        std::vector<std::vector<int>> connections(numLines);
+        if (numLines == 0) {
+            return connections;
+        }
+
+        std::vector<Segment> segments;
+        segments.reserve(numLines);
+        double minX = lines.front().start().x, maxX = minX;
+        double minY = lines.front().start().y, maxY = minY;
+        for (const auto &line : lines) {
+            segments.push_back({line.start().x, line.start().y, line.end().x, line.end().y});
+            minX = std::min({minX, line.start().x, line.end().x});
+            maxX = std::max({maxX, line.start().x, line.end().x});
+            minY = std::min({minY, line.start().y, line.end().y});
+            maxY = std::max({maxY, line.start().y, line.end().y});
+        }
+        double cellSize = std::max(std::max(maxX - minX, maxY - minY) /
+                                       std::ceil(std::sqrt(static_cast<double>(numLines))),
+                                   tolerance * 4);
+        if (cellSize <= 0) {
+            // all the lines are at the same point
+            cellSize = 1;
+        }
+        SegmentIndex::SegmentGrid grid(minX, minY, maxX, maxY, cellSize);
+        grid.build(segments, tolerance);
+
+        if (comm) {
+            comm->CommPostMessage(Communicator::NUM_RECORDS, numLines);
+        }
+
+        // Every line only keeps the lines after it that it connects to, so
+        // that each pair is tested once, and the grid is only read here
+        std::vector<std::vector<int>> laterConnections(numLines);
+        nthreads = Parallel::getNumThreads(nthreads, numLines);
+        std::atomic<size_t> nextLine(0);
+        Parallel::forEachThread(nthreads, comm, [&](int, Communicator *threadComm) {
+            std::vector<uint32_t> candidates;
+            for (size_t lineIdx = nextLine++; lineIdx < numLines; lineIdx = nextLine++) {
+                threadComm->CommPostMessage(Communicator::CURRENT_RECORD, lineIdx);
+                if (threadComm->IsCancelled()) {
+                    throw Communicator::CancelledException();
+                }
+                const auto &segment = segments[lineIdx];
+                candidates.clear();
+                grid.forEachItem(segment[0], segment[1], segment[2], segment[3], tolerance,
+                                 [&candidates, lineIdx](uint32_t item) {
+                                     if (item > lineIdx) {
+                                         candidates.push_back(item);
+                                     }
+                                 });
+                std::sort(candidates.begin(), candidates.end());
+                candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                                 candidates.end());
+                auto &lineConnections = laterConnections[lineIdx];
+                for (uint32_t candidate : candidates) {
+                    if (segmentsConnect(segment, segments[candidate], tolerance)) {
+                        lineConnections.push_back(static_cast<int>(candidate));
+                    }
+                }
+            }
+        });
+
+        // Lines are visited in order, so the lines before each line are
+        // added to its connections in order as well, ahead of the ones after
+        for (size_t lineIdx = 0; lineIdx < numLines; ++lineIdx) {
+            for (int other : laterConnections[lineIdx]) {
+                connections[other].push_back(static_cast<int>(lineIdx));
+            }
+        }
+        for (size_t lineIdx = 0; lineIdx < numLines; ++lineIdx) {
+            auto &lineConnections = connections[lineIdx];
+            lineConnections.insert(lineConnections.end(), laterConnections[lineIdx].begin(),
+                                   laterConnections[lineIdx].end());
+        }
+        return connections;
+    }
+
+    std::unique_ptr<ShapeGraph> convertDataToAxial(Communicator *comm, const std::string &name,
+                                                   ShapeMap &shapeMap, bool copydata,
+                                                   int nthreads) {
+        // every line of every shape, along with the shape it came from
+        std::vector<Line4f> lines;
+        std::vector<int> shapeRefs;
+        for (const auto &shape : shapeMap.getAllShapes()) {
+            for (const auto &line : shape.second.getAsLines()) {
+                lines.push_back(line);
+                shapeRefs.push_back(shape.first);
+            }
+        }
+        if (lines.empty()) {
+            Rcpp::stop("No lines found in data map");
+        }
+
+        Region4f region = shapeMap.getRegion();
+        auto axialMap = std::make_unique<ShapeGraph>(name, ShapeMap::AXIALMAP);
+        axialMap->init(lines.size(), region);
+        axialMap->initialiseAttributesAxial();
+
+        AttributeTable &table = axialMap->getAttributeTable();
+        int connectivityCol = table.getOrInsertColumn("Connectivity");
+        int lineLengthCol = table.getOrInsertColumn("Line Length");
+        int dataMapRefCol = table.getOrInsertColumn("Data Map Ref");
+
+        const AttributeTable &dataTable = shapeMap.getAttributeTable();
+        std::vector<std::pair<size_t, int>> copiedCols;
+        if (copydata) {
+            for (size_t col = 0; col < dataTable.getNumColumns(); ++col) {
+                copiedCols.emplace_back(col, table.getOrInsertColumn(dataTable.getColumnName(col)));
+            }
+        }
+
+        std::vector<int> axialRefs;
+        axialRefs.reserve(lines.size());
+        for (const auto &line : lines) {
+            axialRefs.push_back(
+                axialMap->makeLineShape(line, false /* through_ui */, false /* tempshape */));
+        }
+
+        double tolerance = RELATIVE_TOLERANCE * std::max(region.width(), region.height());
+        auto lineConnections = findLineConnections(comm, lines, tolerance, nthreads);
+
+        // The lines were added in order, so the connectors (one per shape,
+        // in the order of the shapes) follow the order of the lines
+        auto &connectors = axialMap->getConnections();
+        connectors.clear();
+        connectors.resize(lines.size());
+        for (size_t lineIdx = 0; lineIdx < lines.size(); ++lineIdx) {
+            const auto &connections = lineConnections[lineIdx];
+            connectors[lineIdx].connections.assign(connections.begin(), connections.end());
+
+            AttributeRow &row = table.getRow(AttributeKey(axialRefs[lineIdx]));
+            row.setValue(connectivityCol, static_cast<float>(connections.size()));
+            row.setValue(lineLengthCol, static_cast<float>(lines[lineIdx].length()));
+            row.setValue(dataMapRefCol, static_cast<float>(shapeRefs[lineIdx]));
+            if (!copiedCols.empty()) {
+                const AttributeRow &dataRow = dataTable.getRow(AttributeKey(shapeRefs[lineIdx]));
+                for (const auto &copiedCol : copiedCols) {
+                    row.setValue(copiedCol.second, dataRow.getValue(copiedCol.first));
+                }
+            }
+        }
+        return axialMap;
+    }
+
+} // namespace AxialConversion
@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Multi-threaded conversion of data maps to axial maps. The lines are put in
+// a uniform grid (the broad phase) and every thread tests the lines it takes
+// against the other lines that share a cell with them (the narrow phase). The
+// pairs found are then put together in the order of the lines, so that the
+// connections do not depend on the number of threads.
+
+#pragma once
+
+#include "salalib/genlib/line4f.hpp"
+#include "salalib/shapegraph.hpp"
+#include "salalib/shapemap.hpp"
+
+#include "communicator.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace AxialConversion {
+
+    // For each line, the (sorted) indices of the other lines that it crosses
+    // or touches, within the tolerance
+    std::vector<std::vector<int>> findLineConnections(Communicator *comm,
+                                                      const std::vector<Line4f> &lines,
+                                                      double tolerance, int nthreads);
+
+    // Equivalent of sala's MapConverter::convertDataToAxial, with the
+    // connections of the lines found by findLineConnections
+    std::unique_ptr<ShapeGraph> convertDataToAxial(Communicator *comm, const std::string &name,
+                                                   ShapeMap &shapeMap, bool copydata,
+                                                   int nthreads);
+
+} // namespace AxialConversion
@@ -0,0 +1,920 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_axialTraversal.hpp"
+
+#include "engine_segmentFullAngular.hpp"
+#include "helper_parallel.hpp"
+
+#include <Rcpp.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+
+namespace AxialTraversal {
+
+    namespace {
+        // Normalisation values from the Depthmap 4 manual, where k is the
+        // number of nodes (including the origin)
+        double dvalue(double k) {
+            return 2.0 * (k * (std::log2((k + 2.0) / 3.0) - 1.0) + 1.0) / ((k - 1.0) * (k - 2.0));
+        }
+        double pvalue(double k) { return 2.0 * (k - std::log2(k) - 1.0) / ((k - 1.0) * (k - 2.0)); }
+        double teklinteg(double nodeCount, double totalDepth) {
+            return std::log(0.5 * (nodeCount - 2.0)) / std::log(totalDepth - nodeCount + 1.0);
+        }
+
+        std::string getRadiusText(int radius) {
+            return radius < 0 ? std::string() : " R" + std::to_string(radius);
+        }
+
+        // Output values, one vector (indexed by line) per column, in the
+        // order in which the columns are to be added to the map
+        struct Columns {
+            std::vector<std::string> names;
+            std::vector<std::vector<float>> values;
+
+            int add(const std::string &name, size_t numLines) {
+                names.push_back(name);
+                values.emplace_back(numLines, -1.0f);
+                return static_cast<int>(names.size() - 1);
+            }
+        };
+
+        // Indices (in Columns) of the outputs of a single radius, -1 where
+        // the output is not requested
+        struct RadiusColumns {
+            int choice = -1, choiceNorm = -1, wChoice = -1, wChoiceNorm = -1;
+            int meanDepth = -1, nodeCount = -1, integHH = -1, wMeanDepth = -1, totalWeight = -1;
+            int entropy = -1, integPV = -1, integTk = -1, intensity = -1, harmonic = -1,
+                relEntropy = -1;
+            int ra = -1, rra = -1, totalDepth = -1;
+        };
+
+        // Traversal buffers of a single thread. The depth of the lines is
+        // reset after every search by walking the lines found, so that it
+        // does not have to be cleared in full for every origin
+        struct Traversal {
+            std::vector<int> depth;
+            std::vector<uint32_t> parent;
+            // lines in the order they were found, which is also by depth
+            std::vector<uint32_t> order;
+            std::vector<int> levelCounts;
+            std::vector<double> levelWeights;
+            std::vector<double> subtree, wSubtree;
+
+            Traversal(size_t numLines)
+                : depth(numLines, -1), parent(numLines, 0), subtree(numLines, 0.0),
+                  wSubtree(numLines, 0.0) {}
+
+            void run(const AxialGraph &graph, uint32_t origin, int maxRadius,
+                     const std::vector<double> &weights) {
+                for (uint32_t line : order) {
+                    depth[line] = -1;
+                }
+                order.clear();
+                levelCounts.assign(1, 1);
+                levelWeights.assign(1, weights.empty() ? 0.0 : weights[origin]);
+
+                depth[origin] = 0;
+                parent[origin] = origin;
+                order.push_back(origin);
+
+                size_t levelStart = 0;
+                for (int level = 0; maxRadius < 0 || level < maxRadius; ++level) {
+                    size_t levelEnd = order.size();
+                    int levelCount = 0;
+                    double levelWeight = 0.0;
+                    // sala pops the lines of a level from the back of its
+                    // list, so they are expanded in reverse, which decides
+                    // the parent of lines that can be reached from more than
+                    // one line of the level (and thus choice)
+                    for (size_t pos = levelEnd; pos-- > levelStart;) {
+                        uint32_t line = order[pos];
+                        for (size_t edge = graph.beginEdges(line); edge < graph.endEdges(line);
+                             ++edge) {
+                            uint32_t target = graph.getTarget(edge);
+                            if (depth[target] == -1) {
+                                depth[target] = level + 1;
+                                parent[target] = line;
+                                order.push_back(target);
+                                ++levelCount;
+                                if (!weights.empty()) {
+                                    levelWeight += weights[target];
+                                }
+                            }
+                        }
+                    }
+                    if (levelCount == 0) {
+                        break;
+                    }
+                    levelCounts.push_back(levelCount);
+                    levelWeights.push_back(levelWeight);
+                    levelStart = levelEnd;
+                }
+            }
+        };
+
+        // Breadth-first search from up to 64 origins at once, with one bit of
+        // a machine word per origin. Without choice only the number of lines
+        // (and their weight) at each depth is needed, so a level of all the
+        // origins is advanced with a single word operation per connection
+        struct BitTraversal {
+            static constexpr size_t WIDTH = 64;
+
+            std::vector<uint64_t> visited, frontier, next;
+            std::array<std::vector<int>, WIDTH> levelCounts;
+            std::array<std::vector<double>, WIDTH> levelWeights;
+
+            BitTraversal(size_t numLines)
+                : visited(numLines, 0), frontier(numLines, 0), next(numLines, 0) {}
+
+            static int lowestBit(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+                return __builtin_ctzll(bits);
+#else
+                int idx = 0;
+                while ((bits & 1) == 0) {
+                    bits >>= 1;
+                    ++idx;
+                }
+                return idx;
+#endif
+            }
+
+            void run(const AxialGraph &graph, size_t firstOrigin, size_t numOrigins,
+                     int maxRadius, const std::vector<double> &weights) {
+                const size_t numLines = graph.getNumLines();
+                std::fill(visited.begin(), visited.end(), 0);
+                std::fill(frontier.begin(), frontier.end(), 0);
+                for (size_t bit = 0; bit < numOrigins; ++bit) {
+                    visited[firstOrigin + bit] = frontier[firstOrigin + bit] = uint64_t(1) << bit;
+                    levelCounts[bit].assign(1, 1);
+                    levelWeights[bit].assign(1, weights.empty() ? 0.0 : weights[firstOrigin + bit]);
+                }
+
+                for (int level = 0; maxRadius < 0 || level < maxRadius; ++level) {
+                    std::fill(next.begin(), next.end(), 0);
+                    for (size_t line = 0; line < numLines; ++line) {
+                        if (frontier[line] == 0) {
+                            continue;
+                        }
+                        for (size_t edge = graph.beginEdges(line); edge < graph.endEdges(line);
+                             ++edge) {
+                            next[graph.getTarget(edge)] |= frontier[line];
+                        }
+                    }
+
+                    bool found = false;
+                    for (size_t line = 0; line < numLines; ++line) {
+                        uint64_t newBits = next[line] & ~visited[line];
+                        frontier[line] = newBits;
+                        if (newBits == 0) {
+                            continue;
+                        }
+                        found = true;
+                        visited[line] |= newBits;
+                        for (; newBits != 0; newBits &= newBits - 1) {
+                            int bit = lowestBit(newBits);
+                            // the levels of each origin are contiguous, so a
+                            // new level is only ever appended at the end
+                            if (levelCounts[bit].size() == static_cast<size_t>(level) + 1) {
+                                levelCounts[bit].push_back(0);
+                                levelWeights[bit].push_back(0.0);
+                            }
+                            ++levelCounts[bit].back();
+                            if (!weights.empty()) {
+                                levelWeights[bit].back() += weights[line];
+                            }
+                        }
+                    }
+                    if (!found) {
+                        break;
+                    }
+                }
+            }
+        };
+
+        void setMetrics(Columns &columns, const RadiusColumns &radiusColumns, size_t lineIdx,
+                        const std::vector<int> &levelCounts,
+                        const std::vector<double> &levelWeights, int radius, bool weighted) {
+            size_t maxLevel = levelCounts.size() - 1;
+            if (radius >= 0 && static_cast<size_t>(radius) < maxLevel) {
+                maxLevel = static_cast<size_t>(radius);
+            }
+
+            // node count includes the origin itself
+            double nodeCount = 0.0, totalDepth = 0.0, totalWeight = 0.0, wTotalDepth = 0.0;
+            for (size_t level = 0; level <= maxLevel; ++level) {
+                nodeCount += levelCounts[level];
+                totalDepth += static_cast<double>(level * levelCounts[level]);
+                totalWeight += levelWeights[level];
+                wTotalDepth += static_cast<double>(level) * levelWeights[level];
+            }
+
+            auto set = [&columns, lineIdx](int col, double value) {
+                if (col != -1) {
+                    columns.values[col][lineIdx] = static_cast<float>(value);
+                }
+            };
+
+            set(radiusColumns.nodeCount, nodeCount);
+            if (nodeCount <= 1) {
+                return;
+            }
+
+            // mean depth as per p.108 Social Logic of Space
+            double meanDepth = totalDepth / (nodeCount - 1.0);
+            set(radiusColumns.meanDepth, meanDepth);
+            if (weighted) {
+                set(radiusColumns.wMeanDepth, wTotalDepth / totalWeight);
+                set(radiusColumns.totalWeight, totalWeight);
+            }
+
+            set(radiusColumns.totalDepth, totalDepth);
+            if (nodeCount > 2 && meanDepth > 1.0) {
+                double ra = 2.0 * (meanDepth - 1.0) / (nodeCount - 2.0);
+                double rraD = ra / dvalue(nodeCount);
+                double rraP = ra / pvalue(nodeCount);
+                set(radiusColumns.integHH, 1.0 / rraD);
+                set(radiusColumns.integPV, 1.0 / rraP);
+                if (totalDepth - nodeCount + 1 > 1) {
+                    set(radiusColumns.integTk, teklinteg(nodeCount, totalDepth));
+                }
+                set(radiusColumns.ra, ra);
+                set(radiusColumns.rra, rraD);
+            }
+
+            double entropy = 0.0, relEntropy = 0.0, factorial = 1.0, harmonic = 0.0;
+            for (size_t level = 0; level <= maxLevel; ++level) {
+                if (levelCounts[level] == 0) {
+                    continue;
+                }
+                double prob = levelCounts[level] / nodeCount;
+                entropy -= prob * std::log2(prob);
+                // Formula from Turner 2001, "Depthmap"
+                factorial *= static_cast<double>(level + 1);
+                double q = (std::pow(meanDepth, static_cast<double>(level)) / factorial) *
+                           std::exp(-meanDepth);
+                relEntropy += prob * std::log2(prob / q);
+                harmonic += 1.0 / levelCounts[level];
+            }
+            set(radiusColumns.entropy, entropy);
+            set(radiusColumns.relEntropy, relEntropy);
+            set(radiusColumns.harmonic, static_cast<double>(maxLevel + 1) / harmonic);
+            set(radiusColumns.intensity,
+                totalDepth > nodeCount ? nodeCount * entropy / (totalDepth - nodeCount) : -1.0);
+        }
+
+        // End points of the lines of an axial map, by line index
+        struct LineGeometry {
+            std::vector<double> x0, y0, x1, y1;
+
+            LineGeometry(ShapeGraph &map, size_t numLines) {
+                const auto &lines = map.getAllShapesAsLines();
+                if (lines.size() != numLines) {
+                    Rcpp::stop("Axial map lines (%d) do not match its shapes (%d)", lines.size(),
+                               numLines);
+                }
+                for (const auto &line : lines) {
+                    x0.push_back(line.start().x);
+                    y0.push_back(line.start().y);
+                    x1.push_back(line.end().x);
+                    y1.push_back(line.end().y);
+                }
+            }
+
+            size_t size() const { return x0.size(); }
+            double getLength(size_t lineIdx) const {
+                return std::hypot(x1[lineIdx] - x0[lineIdx], y1[lineIdx] - y0[lineIdx]);
+            }
+            double getX(size_t lineIdx, double t) const {
+                return x0[lineIdx] + t * (x1[lineIdx] - x0[lineIdx]);
+            }
+            double getY(size_t lineIdx, double t) const {
+                return y0[lineIdx] + t * (y1[lineIdx] - y0[lineIdx]);
+            }
+            // position (0 at the start and 1 at the end) of the point of the
+            // line closest to (x, y)
+            double project(size_t lineIdx, double x, double y) const {
+                double dx = x1[lineIdx] - x0[lineIdx], dy = y1[lineIdx] - y0[lineIdx];
+                double length2 = dx * dx + dy * dy;
+                if (length2 == 0) {
+                    return 0.0;
+                }
+                return std::clamp(((x - x0[lineIdx]) * dx + (y - y0[lineIdx]) * dy) / length2,
+                                  0.0, 1.0);
+            }
+        };
+
+        // Uniform grid over the lines, so that a batch of points can be
+        // matched to the lines that touch them without a region query to the
+        // map for every point. Each line is only added to the cells it passes
+        // through, not to all the cells of its bounding box
+        class LineLocator {
+            const LineGeometry &m_lines;
+            double m_minX = 0, m_minY = 0, m_maxX = 0, m_maxY = 0;
+            double m_cellSize = 1, m_tolerance = 0;
+            size_t m_cols = 1, m_rows = 1;
+            std::vector<size_t> m_offsets;
+            std::vector<uint32_t> m_lineIdxs;
+
+            size_t getCol(double x) const {
+                return std::min(m_cols - 1,
+                                static_cast<size_t>(std::max(0.0, (x - m_minX) / m_cellSize)));
+            }
+            size_t getRow(double y) const {
+                return std::min(m_rows - 1,
+                                static_cast<size_t>(std::max(0.0, (y - m_minY) / m_cellSize)));
+            }
+
+          public:
+            LineLocator(const LineGeometry &lines) : m_lines(lines) {
+                if (lines.size() == 0) {
+                    m_offsets.assign(2, 0);
+                    return;
+                }
+                m_minX = std::min(*std::min_element(lines.x0.begin(), lines.x0.end()),
+                                  *std::min_element(lines.x1.begin(), lines.x1.end()));
+                m_minY = std::min(*std::min_element(lines.y0.begin(), lines.y0.end()),
+                                  *std::min_element(lines.y1.begin(), lines.y1.end()));
+                m_maxX = std::max(*std::max_element(lines.x0.begin(), lines.x0.end()),
+                                  *std::max_element(lines.x1.begin(), lines.x1.end()));
+                m_maxY = std::max(*std::max_element(lines.y0.begin(), lines.y0.end()),
+                                  *std::max_element(lines.y1.begin(), lines.y1.end()));
+                double extent = std::max(m_maxX - m_minX, m_maxY - m_minY);
+                // the coordinates are kept as floats in sala, so points given
+                // on a line are only expected to be on it to float precision
+                m_tolerance = std::max(extent, 1.0) * 1e-6;
+                double cellsPerSide = std::ceil(std::sqrt(static_cast<double>(lines.size())));
+                m_cellSize = std::max(extent / cellsPerSide, m_tolerance * 4);
+                m_cols = static_cast<size_t>((m_maxX - m_minX) / m_cellSize) + 1;
+                m_rows = static_cast<size_t>((m_maxY - m_minY) / m_cellSize) + 1;
+
+                // The line is walked in steps of half a cell, and the cells
+                // of the box around each step (padded by the tolerance) are
+                // added, which covers every cell the line passes through
+                std::vector<std::pair<size_t, uint32_t>> cellLines;
+                std::vector<size_t> lineCells;
+                for (size_t lineIdx = 0; lineIdx < lines.size(); ++lineIdx) {
+                    lineCells.clear();
+                    size_t steps = static_cast<size_t>(
+                                       std::ceil(lines.getLength(lineIdx) / (m_cellSize * 0.5))) +
+                                   1;
+                    for (size_t step = 0; step < steps; ++step) {
+                        double tFrom = static_cast<double>(step) / steps;
+                        double tTo = static_cast<double>(step + 1) / steps;
+                        double xFrom = lines.getX(lineIdx, tFrom), xTo = lines.getX(lineIdx, tTo);
+                        double yFrom = lines.getY(lineIdx, tFrom), yTo = lines.getY(lineIdx, tTo);
+                        size_t colFrom = getCol(std::min(xFrom, xTo) - m_tolerance);
+                        size_t colTo = getCol(std::max(xFrom, xTo) + m_tolerance);
+                        size_t rowFrom = getRow(std::min(yFrom, yTo) - m_tolerance);
+                        size_t rowTo = getRow(std::max(yFrom, yTo) + m_tolerance);
+                        for (size_t row = rowFrom; row <= rowTo; ++row) {
+                            for (size_t col = colFrom; col <= colTo; ++col) {
+                                lineCells.push_back(row * m_cols + col);
+                            }
+                        }
+                    }
+                    std::sort(lineCells.begin(), lineCells.end());
+                    lineCells.erase(std::unique(lineCells.begin(), lineCells.end()),
+                                    lineCells.end());
+                    for (size_t cell : lineCells) {
+                        cellLines.emplace_back(cell, static_cast<uint32_t>(lineIdx));
+                    }
+                }
+
+                // counting sort by cell, which keeps the lines of each cell in
+                // order of index
+                m_offsets.assign(m_cols * m_rows + 1, 0);
+                for (const auto &cellLine : cellLines) {
+                    ++m_offsets[cellLine.first + 1];
+                }
+                for (size_t cell = 0; cell < m_cols * m_rows; ++cell) {
+                    m_offsets[cell + 1] += m_offsets[cell];
+                }
+                m_lineIdxs.resize(cellLines.size());
+                std::vector<size_t> cursor(m_offsets.begin(), m_offsets.end() - 1);
+                for (const auto &cellLine : cellLines) {
+                    m_lineIdxs[cursor[cellLine.first]++] = cellLine.second;
+                }
+            }
+
+            // The lowest index of the lines that touch the point (within the
+            // tolerance), to match the first shape sala would return for the
+            // same point, or -1 if there is none
+            int getLineIdx(double x, double y) const {
+                if (x < m_minX - m_tolerance || x > m_maxX + m_tolerance ||
+                    y < m_minY - m_tolerance || y > m_maxY + m_tolerance) {
+                    return -1;
+                }
+                size_t cell = getRow(y) * m_cols + getCol(x);
+                for (size_t i = m_offsets[cell]; i < m_offsets[cell + 1]; ++i) {
+                    uint32_t lineIdx = m_lineIdxs[i];
+                    double t = m_lines.project(lineIdx, x, y);
+                    if (std::hypot(m_lines.getX(lineIdx, t) - x, m_lines.getY(lineIdx, t) - y) <=
+                        m_tolerance) {
+                        return static_cast<int>(lineIdx);
+                    }
+                }
+                return -1;
+            }
+        };
+
+        constexpr uint32_t NO_POINT = std::numeric_limits<uint32_t>::max();
+
+        // Points where the lines connect, one per connection (i.e. per edge
+        // of the AxialGraph, on the line the edge starts from), so that metric
+        // depth can be measured along the lines. Moving between the points of
+        // a line costs the distance between them, and moving to the matching
+        // point of the other line costs the gap between the two (zero where
+        // the lines cross)
+        struct ConnectionPoints {
+            std::vector<uint32_t> lineIdxs;
+            std::vector<double> positions;
+            std::vector<double> gaps;
+            std::vector<uint32_t> opposites;
+            // the points of each line sorted by position, with the same
+            // offsets as the edges of the graph
+            std::vector<uint32_t> chain;
+            std::vector<size_t> chainPos;
+
+            ConnectionPoints(const AxialGraph &graph, const LineGeometry &lines) {
+                size_t numPoints = graph.endEdges(graph.getNumLines() - 1);
+                lineIdxs.resize(numPoints);
+                positions.resize(numPoints);
+                gaps.resize(numPoints);
+                opposites.assign(numPoints, NO_POINT);
+                chain.resize(numPoints);
+                chainPos.resize(numPoints);
+
+                for (size_t lineIdx = 0; lineIdx < graph.getNumLines(); ++lineIdx) {
+                    double length = lines.getLength(lineIdx);
+                    for (size_t edge = graph.beginEdges(lineIdx); edge < graph.endEdges(lineIdx);
+                         ++edge) {
+                        uint32_t other = graph.getTarget(edge);
+                        lineIdxs[edge] = static_cast<uint32_t>(lineIdx);
+
+                        auto [t, gap] = getConnection(lines, lineIdx, other);
+                        positions[edge] = t * length;
+                        gaps[edge] = gap;
+                        for (size_t otherEdge = graph.beginEdges(other);
+                             otherEdge < graph.endEdges(other); ++otherEdge) {
+                            if (graph.getTarget(otherEdge) == lineIdx) {
+                                opposites[edge] = static_cast<uint32_t>(otherEdge);
+                                break;
+                            }
+                        }
+                        chain[edge] = static_cast<uint32_t>(edge);
+                    }
+                    auto chainBegin = chain.begin() + graph.beginEdges(lineIdx);
+                    auto chainEnd = chain.begin() + graph.endEdges(lineIdx);
+                    std::sort(chainBegin, chainEnd, [this](uint32_t a, uint32_t b) {
+                        return positions[a] < positions[b];
+                    });
+                    for (auto it = chainBegin; it != chainEnd; ++it) {
+                        chainPos[*it] = static_cast<size_t>(std::distance(chain.begin(), it));
+                    }
+                }
+            }
+
+            // The position of the connection on the first line and the gap
+            // to the second. Lines that cross connect at the crossing, and
+            // any others (e.g. linked) at the points closest to their middles
+            static std::pair<double, double> getConnection(const LineGeometry &lines,
+                                                           size_t lineIdx, size_t otherIdx) {
+                double rx = lines.x1[lineIdx] - lines.x0[lineIdx];
+                double ry = lines.y1[lineIdx] - lines.y0[lineIdx];
+                double sx = lines.x1[otherIdx] - lines.x0[otherIdx];
+                double sy = lines.y1[otherIdx] - lines.y0[otherIdx];
+                double qpx = lines.x0[otherIdx] - lines.x0[lineIdx];
+                double qpy = lines.y0[otherIdx] - lines.y0[lineIdx];
+                double denominator = rx * sy - ry * sx;
+                if (denominator != 0) {
+                    constexpr double EPSILON = 1e-6;
+                    double t = (qpx * sy - qpy * sx) / denominator;
+                    double u = (qpx * ry - qpy * rx) / denominator;
+                    if (t >= -EPSILON && t <= 1 + EPSILON && u >= -EPSILON && u <= 1 + EPSILON) {
+                        return {std::clamp(t, 0.0, 1.0), 0.0};
+                    }
+                }
+                double t = lines.project(lineIdx, lines.getX(otherIdx, 0.5),
+                                         lines.getY(otherIdx, 0.5));
+                double u = lines.project(otherIdx, lines.getX(lineIdx, 0.5),
+                                         lines.getY(lineIdx, 0.5));
+                return {t, std::hypot(lines.getX(lineIdx, t) - lines.getX(otherIdx, u),
+                                      lines.getY(lineIdx, t) - lines.getY(otherIdx, u))};
+            }
+        };
+
+        // Topological depth of every line from the closest of the origins,
+        // -1 for lines that can not be reached
+        void getTopologicalDepths(const AxialGraph &graph,
+                                  const std::vector<std::pair<uint32_t, double>> &origins,
+                                  std::vector<float> &depths, std::vector<uint32_t> &queue) {
+            depths.assign(graph.getNumLines(), -1.0f);
+            queue.clear();
+            for (const auto &origin : origins) {
+                if (depths[origin.first] != 0.0f) {
+                    depths[origin.first] = 0.0f;
+                    queue.push_back(origin.first);
+                }
+            }
+            for (size_t pos = 0; pos < queue.size(); ++pos) {
+                uint32_t line = queue[pos];
+                for (size_t edge = graph.beginEdges(line); edge < graph.endEdges(line); ++edge) {
+                    uint32_t target = graph.getTarget(edge);
+                    if (depths[target] < 0) {
+                        depths[target] = depths[line] + 1.0f;
+                        queue.push_back(target);
+                    }
+                }
+            }
+        }
+
+        // Metric depth (distance along the lines) of every line from the
+        // closest of the origin points, -1 for lines that can not be reached
+        void getMetricDepths(const AxialGraph &graph, const ConnectionPoints &points,
+                             const std::vector<std::pair<uint32_t, double>> &origins,
+                             std::vector<float> &depths, std::vector<double> &distances,
+                             FullAngular::RadixHeap<uint32_t> &heap) {
+            depths.assign(graph.getNumLines(), -1.0f);
+            distances.assign(points.positions.size(), -1.0);
+            heap.clear();
+
+            auto relax = [&distances, &heap](uint32_t point, double distance) {
+                if (distances[point] < 0 || distance < distances[point]) {
+                    distances[point] = distance;
+                    heap.push(distance, point);
+                }
+            };
+
+            for (const auto &[lineIdx, position] : origins) {
+                depths[lineIdx] = 0.0f;
+                for (size_t point = graph.beginEdges(lineIdx); point < graph.endEdges(lineIdx);
+                     ++point) {
+                    relax(static_cast<uint32_t>(point),
+                          std::abs(points.positions[point] - position));
+                }
+            }
+
+            while (!heap.empty()) {
+                auto [distance, point] = heap.pop();
+                if (distance > distances[point]) {
+                    continue;
+                }
+                uint32_t lineIdx = points.lineIdxs[point];
+                if (depths[lineIdx] < 0) {
+                    depths[lineIdx] = static_cast<float>(distance);
+                }
+                if (points.opposites[point] != NO_POINT) {
+                    relax(points.opposites[point], distance + points.gaps[point]);
+                }
+                size_t chainPos = points.chainPos[point];
+                if (chainPos > graph.beginEdges(lineIdx)) {
+                    uint32_t previous = points.chain[chainPos - 1];
+                    relax(previous,
+                          distance + points.positions[point] - points.positions[previous]);
+                }
+                if (chainPos + 1 < graph.endEdges(lineIdx)) {
+                    uint32_t next = points.chain[chainPos + 1];
+                    relax(next, distance + points.positions[next] - points.positions[point]);
+                }
+            }
+        }
+    } // namespace
+
+    AxialGraph::AxialGraph(ShapeGraph &map) {
+        const auto &shapes = map.getAllShapes();
+        const auto &connectors = map.getConnections();
+        if (connectors.size() != shapes.size()) {
+            Rcpp::stop("Axial graph connections (%d) do not match its shapes (%d)",
+                       connectors.size(), shapes.size());
+        }
+
+        m_refs.reserve(shapes.size());
+        for (const auto &shape : shapes) {
+            m_refs.push_back(shape.first);
+        }
+
+        m_offsets.reserve(connectors.size() + 1);
+        m_offsets.push_back(0);
+        for (const auto &connector : connectors) {
+            for (int connection : connector.connections) {
+                m_targets.push_back(static_cast<uint32_t>(connection));
+            }
+            m_offsets.push_back(m_targets.size());
+        }
+    }
+
+    int AxialGraph::getIndex(int ref) const {
+        // refs are kept in the (sorted) order of the shapes
+        auto it = std::lower_bound(m_refs.begin(), m_refs.end(), ref);
+        if (it == m_refs.end() || *it != ref) {
+            return -1;
+        }
+        return static_cast<int>(std::distance(m_refs.begin(), it));
+    }
+
+    AnalysisResult runIntegration(Communicator *comm, ShapeGraph &map,
+                                  const std::set<double> &radiusSet, int weightedMeasureColIdx,
+                                  bool includeChoice, bool includeIntermediateMetrics,
+                                  int nthreads) {
+        const AxialGraph graph(map);
+        const size_t numLines = graph.getNumLines();
+        AttributeTable &table = map.getAttributeTable();
+
+        // radius n (-1) is kept last, as in sala
+        std::vector<int> radii;
+        bool radiusN = false;
+        for (double radius : radiusSet) {
+            if (radius < 0) {
+                radiusN = true;
+            } else {
+                radii.push_back(static_cast<int>(radius));
+            }
+        }
+        if (radiusN) {
+            radii.push_back(-1);
+        }
+        int maxRadius = radiusN || radii.empty() ? -1 : radii.back();
+
+        // retrieve the weights before any columns are added, as the weight
+        // column might be overwritten by the analysis
+        bool weighted = weightedMeasureColIdx != -1;
+        std::vector<double> weights;
+        std::string weightColName;
+        if (weighted) {
+            weightColName = table.getColumnName(weightedMeasureColIdx);
+            weights.reserve(numLines);
+            for (size_t lineIdx = 0; lineIdx < numLines; ++lineIdx) {
+                weights.push_back(table.getRow(AttributeKey(graph.getRef(lineIdx)))
+                                      .getValue(weightedMeasureColIdx));
+            }
+        }
+
+        Columns columns;
+        std::vector<RadiusColumns> radiusColumns(radii.size());
+        for (size_t r = 0; r < radii.size(); ++r) {
+            std::string radiusText = getRadiusText(radii[r]);
+            auto &cols = radiusColumns[r];
+            if (includeChoice) {
+                cols.choice = columns.add("Choice" + radiusText, numLines);
+                cols.choiceNorm = columns.add("Choice [Norm]" + radiusText, numLines);
+                if (weighted) {
+                    cols.wChoice =
+                        columns.add("Choice [" + weightColName + " Wgt]" + radiusText, numLines);
+                    cols.wChoiceNorm = columns.add(
+                        "Choice [" + weightColName + " Wgt][Norm]" + radiusText, numLines);
+                }
+            }
+            cols.meanDepth = columns.add("Mean Depth" + radiusText, numLines);
+            cols.nodeCount = columns.add("Node Count" + radiusText, numLines);
+            cols.integHH = columns.add("Integration [HH]" + radiusText, numLines);
+            if (weighted) {
+                cols.wMeanDepth =
+                    columns.add("Mean Depth [" + weightColName + " Wgt]" + radiusText, numLines);
+                cols.totalWeight = columns.add("Total " + weightColName + radiusText, numLines);
+            }
+            cols.entropy = columns.add("Entropy" + radiusText, numLines);
+            cols.integPV = columns.add("Integration [P-value]" + radiusText, numLines);
+            cols.integTk = columns.add("Integration [Tekl]" + radiusText, numLines);
+            cols.intensity = columns.add("Intensity" + radiusText, numLines);
+            cols.harmonic = columns.add("Harmonic Mean Depth" + radiusText, numLines);
+            cols.relEntropy = columns.add("Relativised Entropy" + radiusText, numLines);
+            if (includeIntermediateMetrics) {
+                cols.ra = columns.add("RA" + radiusText, numLines);
+                cols.rra = columns.add("RRA" + radiusText, numLines);
+                cols.totalDepth = columns.add("Total Depth" + radiusText, numLines);
+            }
+        }
+
+        if (comm) {
+            comm->CommPostMessage(Communicator::NUM_RECORDS, numLines);
+        }
+
+        nthreads = Parallel::getNumThreads(nthreads, numLines);
+
+        // choice accumulators per thread and radius, added up at the end
+        std::vector<std::vector<std::vector<double>>> threadChoice(nthreads),
+            threadWChoice(nthreads);
+
+        std::atomic<size_t> nextOrigin(0);
+        if (!includeChoice) {
+            // origins are handed out in batches, one per word
+            size_t numBatches = (numLines + BitTraversal::WIDTH - 1) / BitTraversal::WIDTH;
+            Parallel::forEachThread(
+                Parallel::getNumThreads(nthreads, numBatches), comm,
+                [&](int, Communicator *threadComm) {
+                    BitTraversal traversal(numLines);
+                    for (size_t firstOrigin = nextOrigin.fetch_add(BitTraversal::WIDTH);
+                         firstOrigin < numLines;
+                         firstOrigin = nextOrigin.fetch_add(BitTraversal::WIDTH)) {
+                        threadComm->CommPostMessage(Communicator::CURRENT_RECORD, firstOrigin);
+                        if (threadComm->IsCancelled()) {
+                            throw Communicator::CancelledException();
+                        }
+
+                        size_t numOrigins = std::min(BitTraversal::WIDTH, numLines - firstOrigin);
+                        traversal.run(graph, firstOrigin, numOrigins, maxRadius, weights);
+                        for (size_t bit = 0; bit < numOrigins; ++bit) {
+                            for (size_t r = 0; r < radii.size(); ++r) {
+                                setMetrics(columns, radiusColumns[r], firstOrigin + bit,
+                                           traversal.levelCounts[bit], traversal.levelWeights[bit],
+                                           radii[r], weighted);
+                            }
+                        }
+                    }
+                });
+        } else {
+            Parallel::forEachThread(nthreads, comm, [&](int threadIdx, Communicator *threadComm) {
+                Traversal traversal(numLines);
+                auto &choice = threadChoice[threadIdx];
+                auto &wChoice = threadWChoice[threadIdx];
+                choice.assign(radii.size(), std::vector<double>(numLines, 0.0));
+                if (weighted) {
+                    wChoice.assign(radii.size(), std::vector<double>(numLines, 0.0));
+                }
+
+                for (size_t originIdx = nextOrigin++; originIdx < numLines;
+                     originIdx = nextOrigin++) {
+                    threadComm->CommPostMessage(Communicator::CURRENT_RECORD, originIdx);
+                    if (threadComm->IsCancelled()) {
+                        throw Communicator::CancelledException();
+                    }
+
+                    traversal.run(graph, static_cast<uint32_t>(originIdx), maxRadius, weights);
+
+                    for (size_t r = 0; r < radii.size(); ++r) {
+                        setMetrics(columns, radiusColumns[r], originIdx, traversal.levelCounts,
+                                   traversal.levelWeights, radii[r], weighted);
+                        // Choice through each line is the number of lines
+                        // found beyond it in the search tree. As the lines are
+                        // found in order of depth, those within the radius are
+                        // a prefix of the order and the tree can be rolled up
+                        // from its end
+                        int reached = 0;
+                        for (size_t level = 0;
+                             level < traversal.levelCounts.size() &&
+                             (radii[r] < 0 || static_cast<int>(level) <= radii[r]);
+                             ++level) {
+                            reached += traversal.levelCounts[level];
+                        }
+                        for (int pos = 0; pos < reached; ++pos) {
+                            uint32_t line = traversal.order[pos];
+                            traversal.subtree[line] = 1.0;
+                            traversal.wSubtree[line] = weighted ? weights[line] : 0.0;
+                        }
+                        for (int pos = reached - 1; pos > 0; --pos) {
+                            uint32_t line = traversal.order[pos];
+                            uint32_t parent = traversal.parent[line];
+                            choice[r][line] += traversal.subtree[line] - 1.0;
+                            traversal.subtree[parent] += traversal.subtree[line];
+                            if (weighted) {
+                                wChoice[r][line] += (traversal.wSubtree[line] - weights[line]) *
+                                                    weights[originIdx];
+                                traversal.wSubtree[parent] += traversal.wSubtree[line];
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+        if (includeChoice) {
+            for (size_t r = 0; r < radii.size(); ++r) {
+                const auto &cols = radiusColumns[r];
+                for (size_t lineIdx = 0; lineIdx < numLines; ++lineIdx) {
+                    // every pair has been traversed from both ends
+                    double choice = 0.0, wChoice = 0.0;
+                    for (int threadIdx = 0; threadIdx < nthreads; ++threadIdx) {
+                        choice += threadChoice[threadIdx][r][lineIdx] * 0.5;
+                        if (weighted) {
+                            wChoice += threadWChoice[threadIdx][r][lineIdx] * 0.5;
+                        }
+                    }
+                    double nodeCount = columns.values[cols.nodeCount][lineIdx];
+                    columns.values[cols.choice][lineIdx] = static_cast<float>(choice);
+                    columns.values[cols.choiceNorm][lineIdx] =
+                        nodeCount > 2
+                            ? static_cast<float>(2.0 * choice / ((nodeCount - 1) * (nodeCount - 2)))
+                            : -1.0f;
+                    if (weighted) {
+                        double totalWeight = columns.values[cols.totalWeight][lineIdx];
+                        columns.values[cols.wChoice][lineIdx] = static_cast<float>(wChoice);
+                        columns.values[cols.wChoiceNorm][lineIdx] =
+                            totalWeight > 0
+                                ? static_cast<float>(wChoice / (totalWeight * totalWeight))
+                                : -1.0f;
+                    }
+                }
+            }
+        }
+
+        AnalysisResult result;
+        for (size_t col = 0; col < columns.names.size(); ++col) {
+            auto colIdx = table.getOrInsertColumn(columns.names[col]);
+            for (size_t lineIdx = 0; lineIdx < numLines; ++lineIdx) {
+                table.getRow(AttributeKey(graph.getRef(lineIdx)))
+                    .setValue(colIdx, columns.values[col][lineIdx]);
+            }
+            result.addAttribute(columns.names[col]);
+        }
+        result.completed = true;
+        return result;
+    }
+
+    AnalysisResult runStepDepth(Communicator *comm, ShapeGraph &map, TraversalType stepType,
+                                const std::vector<std::vector<Point2f>> &groupPoints,
+                                const std::vector<std::string> &groupNames, int nthreads) {
+        if (stepType != TraversalType::Topological && stepType != TraversalType::Metric) {
+            Rcpp::stop("Only topological and metric depth are available for axial maps");
+        }
+
+        const AxialGraph graph(map);
+        const LineGeometry lines(map, graph.getNumLines());
+        const LineLocator locator(lines);
+
+        // all the points are resolved here, before any threads are started
+        auto graphRegion = map.getRegion();
+        std::vector<std::vector<std::pair<uint32_t, double>>> groupOrigins(groupPoints.size());
+        for (size_t groupIdx = 0; groupIdx < groupPoints.size(); ++groupIdx) {
+            for (const auto &point : groupPoints[groupIdx]) {
+                if (!graphRegion.contains(point)) {
+                    Rcpp::stop("Point outside of target region");
+                }
+                int lineIdx = locator.getLineIdx(point.x, point.y);
+                if (lineIdx == -1) {
+                    // not on any line to float precision, let the map decide
+                    Region4f region(point, point);
+                    auto shapesInRegion = map.getShapesInRegion(region);
+                    if (shapesInRegion.empty()) {
+                        Rcpp::stop("Point (%f %f) does not touch any line", point.x, point.y);
+                    }
+                    lineIdx = graph.getIndex(shapesInRegion.begin()->first);
+                }
+                double position = lines.project(lineIdx, point.x, point.y) *
+                                  lines.getLength(lineIdx);
+                groupOrigins[groupIdx].emplace_back(static_cast<uint32_t>(lineIdx), position);
+            }
+        }
+
+        std::unique_ptr<ConnectionPoints> points;
+        if (stepType == TraversalType::Metric && graph.getNumLines() > 0) {
+            points = std::make_unique<ConnectionPoints>(graph, lines);
+        }
+
+        if (comm) {
+            comm->CommPostMessage(Communicator::NUM_RECORDS, groupOrigins.size());
+        }
+
+        std::vector<std::vector<float>> groupDepths(groupOrigins.size());
+        std::atomic<size_t> nextGroup(0);
+        Parallel::forEachThread(
+            Parallel::getNumThreads(nthreads, groupOrigins.size()), comm,
+            [&](int, Communicator *threadComm) {
+                std::vector<uint32_t> queue;
+                std::vector<double> distances;
+                FullAngular::RadixHeap<uint32_t> heap;
+                for (size_t groupIdx = nextGroup++; groupIdx < groupOrigins.size();
+                     groupIdx = nextGroup++) {
+                    threadComm->CommPostMessage(Communicator::CURRENT_RECORD, groupIdx);
+                    if (threadComm->IsCancelled()) {
+                        throw Communicator::CancelledException();
+                    }
+                    if (points) {
+                        getMetricDepths(graph, *points, groupOrigins[groupIdx],
+                                        groupDepths[groupIdx], distances, heap);
+                    } else {
+                        getTopologicalDepths(graph, groupOrigins[groupIdx], groupDepths[groupIdx],
+                                             queue);
+                    }
+                }
+            });
+
+        AttributeTable &table = map.getAttributeTable();
+        std::string depthColName =
+            stepType == TraversalType::Metric ? "Metric Step Depth" : "Step Depth";
+        AnalysisResult result;
+        for (size_t groupIdx = 0; groupIdx < groupDepths.size(); ++groupIdx) {
+            std::string colName = groupNames.empty()
+                                      ? depthColName
+                                      : depthColName + " [" + groupNames[groupIdx] + "]";
+            auto colIdx = table.getOrInsertColumn(colName);
+            for (size_t lineIdx = 0; lineIdx < graph.getNumLines(); ++lineIdx) {
+                table.getRow(AttributeKey(graph.getRef(lineIdx)))
+                    .setValue(colIdx, groupDepths[groupIdx][lineIdx]);
+            }
+            result.addAttribute(colName);
+        }
+        result.completed = true;
+        return result;
+    }
+
+} // namespace AxialTraversal
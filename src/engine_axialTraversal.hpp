@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Multi-threaded traversal of axial maps. The connections of the map are
+// flattened once into a read-only graph that all threads share, and every
+// thread keeps its own traversal buffers and accumulators, so that origins
+// can be handed out to threads as they become free.
+
+#pragma once
+
+#include "salalib/analysisresult.hpp"
+#include "salalib/shapegraph.hpp"
+
+#include "enum_TraversalType.hpp"
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace AxialTraversal {
+
+    // Flattened, read-only copy of the connections of an axial ShapeGraph,
+    // indexed by the position of each line in the map
+    class AxialGraph {
+        std::vector<int> m_refs;
+        std::vector<size_t> m_offsets;
+        std::vector<uint32_t> m_targets;
+
+      public:
+        AxialGraph(ShapeGraph &map);
+
+        size_t getNumLines() const { return m_refs.size(); }
+        int getRef(size_t lineIdx) const { return m_refs[lineIdx]; }
+        // the index of the line with the given shape ref or -1
+        int getIndex(int ref) const;
+
+        size_t beginEdges(size_t lineIdx) const { return m_offsets[lineIdx]; }
+        size_t endEdges(size_t lineIdx) const { return m_offsets[lineIdx + 1]; }
+        uint32_t getTarget(size_t edge) const { return m_targets[edge]; }
+    };
+
+    // Equivalent of sala's AxialIntegration (non-simple version) that splits
+    // the origins between threads. A single breadth-first search is run per
+    // origin and all radii are read off its depth levels. When choice is not
+    // requested, 64 origins are searched at once, one per bit of a word. The
+    // radius -1 is radius n. Only used when more than one thread is asked
+    // for, as a single thread runs AxialIntegration itself
+    AnalysisResult runIntegration(Communicator *comm, ShapeGraph &map,
+                                  const std::set<double> &radiusSet, int weightedMeasureColIdx,
+                                  bool includeChoice, bool includeIntermediateMetrics,
+                                  int nthreads);
+
+    // Topological or metric (along the lines) depth from groups of origin
+    // points, one column per group named after it, or a single column if no
+    // group names are given. The points are matched to lines in bulk through
+    // a grid over the lines, and the groups are split between threads
+    AnalysisResult runStepDepth(Communicator *comm, ShapeGraph &map, TraversalType stepType,
+                                const std::vector<std::vector<Point2f>> &groupPoints,
+                                const std::vector<std::string> &groupNames, int nthreads);
+
+} // namespace AxialTraversal
@@ -0,0 +1,65 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Isovists by casting a fixed fan of rays from the origin, as an alternative
+// to walking the BSP tree. The boundary lines are packed in separate arrays
+// per coordinate so that a ray is tested against consecutive lines in SIMD
+// lanes. With many origins and a modest number of lines this avoids the
+// pointer chasing of the tree, at the cost of the polygon only being as
+// detailed as the number of rays.
+
+#pragma once
+
+#include "salalib/genlib/line4f.hpp"
+#include "salalib/genlib/region4f.hpp"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace IsovistRays {
+
+    // Structure-of-arrays copy of the boundary lines: the start of each line
+    // and the vector from its start to its end
+    class LineBuffer {
+        std::vector<double> m_startX, m_startY, m_vectorX, m_vectorY;
+
+      public:
+        LineBuffer(const std::vector<Line4f> &lines);
+
+        size_t size() const { return m_startX.size(); }
+
+        // The distance along the (unit) ray to the closest line it hits and
+        // the index of that line, or maxDistance and -1 if it hits none. The
+        // distances buffer is scratch space of at least size() elements
+        std::pair<double, int> castRay(double originX, double originY, double unitX, double unitY,
+                                       double maxDistance, std::vector<double> &distances) const;
+
+        // Whether the two lines share an end
+        bool shareEnd(int lineA, int lineB, double tolerance) const;
+    };
+
+    // The polygon of an isovist and the measures that sala gives for it
+    struct Isovist {
+        std::vector<Point2f> polygon;
+        double area = 0;
+        double perimeter = 0;
+        // from the origin to the centroid of the polygon, angle in radians
+        double driftMagnitude = 0;
+        double driftAngle = 0;
+        double minRadial = 0;
+        double maxRadial = 0;
+        // length of the edges of the polygon that are not on the boundary
+        double occlusivity = 0;
+    };
+
+    // Casts numRays rays from the origin, spread evenly from leftAngle to
+    // rightAngle (counter-clockwise), or around the whole circle if the two
+    // are the same or not finite. Rays that hit no line end at the edge of
+    // the region
+    Isovist makeIsovist(const LineBuffer &lines, const Region4f &region, const Point2f &origin,
+                        double leftAngle, double rightAngle, int numRays,
+                        std::vector<double> &distances);
+
+} // namespace IsovistRays
@@ -0,0 +1,100 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_latticeBlocking.hpp"
+
+#include "helper_parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace LatticeBlocking {
+
+    namespace {
+        // width of the tiles in cells
+        constexpr int TILE_CELLS = 32;
+        // how far (in cells) a line may reach beyond the tile of its middle
+        // and still be blocked with that tile. sala blocks the cells the line
+        // passes through and those it touches, at most a cell further, so the
+        // cells a tile writes stay within half a tile of it and never reach
+        // those of the other tiles of its round, which are a tile apart
+        constexpr int TILE_REACH = TILE_CELLS / 2 - 2;
+    } // namespace
+
+    void blockLines(LatticeMap &latticeMap, const std::vector<Line4f> &lines, int nthreads) {
+        // sala clears the cells of any previous lines
+        std::vector<Line4f> noLines;
+        latticeMap.blockLines(noLines);
+        if (lines.empty()) {
+            return;
+        }
+
+        const Region4f &region = latticeMap.getRegion();
+        const double tileSize = TILE_CELLS * latticeMap.getSpacing();
+        const double reach = TILE_REACH * latticeMap.getSpacing();
+        const size_t tileCols = static_cast<size_t>(region.width() / tileSize) + 1;
+        const size_t tileRows = static_cast<size_t>(region.height() / tileSize) + 1;
+        auto getTile = [tileSize](double value, double min, size_t count) {
+            double tile = std::floor((value - min) / tileSize);
+            return static_cast<size_t>(std::min(std::max(tile, 0.0), count - 1.0));
+        };
+
+        // Each line is blocked as a whole, by the tile of its middle if it
+        // does not reach too far from it. The outer tiles also take what
+        // lies beyond the region. The lines that reach further are blocked
+        // one after the other once the tiles are done
+        std::vector<std::vector<size_t>> tileLines(tileCols * tileRows);
+        std::vector<size_t> longLines;
+        for (size_t lineIdx = 0; lineIdx < lines.size(); ++lineIdx) {
+            const auto &line = lines[lineIdx];
+            double minX = std::min(line.start().x, line.end().x);
+            double maxX = std::max(line.start().x, line.end().x);
+            double minY = std::min(line.start().y, line.end().y);
+            double maxY = std::max(line.start().y, line.end().y);
+            size_t col = getTile((minX + maxX) * 0.5, region.bottom_left.x, tileCols);
+            size_t row = getTile((minY + maxY) * 0.5, region.bottom_left.y, tileRows);
+            double tileMinX = region.bottom_left.x + static_cast<double>(col) * tileSize;
+            double tileMinY = region.bottom_left.y + static_cast<double>(row) * tileSize;
+            bool fits = (col == 0 || minX >= tileMinX - reach) &&
+                        (col + 1 == tileCols || maxX <= tileMinX + tileSize + reach) &&
+                        (row == 0 || minY >= tileMinY - reach) &&
+                        (row + 1 == tileRows || maxY <= tileMinY + tileSize + reach);
+            if (fits) {
+                tileLines[row * tileCols + col].push_back(lineIdx);
+            } else {
+                longLines.push_back(lineIdx);
+            }
+        }
+
+        // the tiles of each round, in order
+        std::vector<size_t> rounds[4];
+        for (size_t tile = 0; tile < tileLines.size(); ++tile) {
+            if (tileLines[tile].empty()) {
+                continue;
+            }
+            size_t col = tile % tileCols, row = tile / tileCols;
+            rounds[(row % 2) * 2 + col % 2].push_back(tile);
+        }
+
+        for (const auto &roundTiles : rounds) {
+            if (roundTiles.empty()) {
+                continue;
+            }
+            int roundThreads = Parallel::getNumThreads(nthreads, roundTiles.size());
+            std::atomic<size_t> nextTile(0);
+            Parallel::forEachThread(roundThreads, nullptr, [&](int, Communicator *) {
+                for (size_t idx = nextTile++; idx < roundTiles.size(); idx = nextTile++) {
+                    for (size_t lineIdx : tileLines[roundTiles[idx]]) {
+                        latticeMap.blockLine(lines[lineIdx]);
+                    }
+                }
+            });
+        }
+        for (size_t lineIdx : longLines) {
+            latticeMap.blockLine(lines[lineIdx]);
+        }
+    }
+
+} // namespace LatticeBlocking
@@ -0,0 +1,25 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Multi-threaded blocking of lattice map cells by boundary lines. The region
+// is split in tiles (each many cells wide) and every line is blocked whole by
+// the tile of its middle, as long as it stays within half a tile of it. The
+// tiles are taken in four rounds, one for each combination of odd and even
+// column and row, so the tiles of a round are at least a tile apart and their
+// threads never block the same cell at the same time and need no locks. Lines
+// that reach further are blocked one by one after the rounds.
+
+#pragma once
+
+#include "salalib/genlib/line4f.hpp"
+#include "salalib/latticemap.hpp"
+
+#include <vector>
+
+namespace LatticeBlocking {
+
+    // Equivalent of sala's LatticeMap::blockLines
+    void blockLines(LatticeMap &latticeMap, const std::vector<Line4f> &lines, int nthreads);
+
+} // namespace LatticeBlocking
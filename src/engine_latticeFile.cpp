@@ -0,0 +1,228 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_latticeFile.hpp"
+
+#include <Rcpp.h>
+
+#include <cstring>
+#include <fstream>
+#include <streambuf>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace LatticeFile {
+
+    namespace {
+        constexpr char MAGIC[8] = {'A', 'L', 'C', 'Y', 'O', 'N', 'L', 'G'};
+        // read back differently on a machine of the other byte order
+        constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+        constexpr uint64_t ALIGNMENT = 8;
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t byteOrder;
+            // bytes of the lattice map as written by sala
+            uint64_t mapSize;
+            uint64_t numCells;
+            uint64_t dataSize;
+        };
+        static_assert(sizeof(Header) == 40, "The header has to be packed");
+
+        uint64_t aligned(uint64_t offset) {
+            return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+
+        // Read-only mapping of a whole file
+        class MappedFile {
+            const uint8_t *m_data = nullptr;
+            size_t m_size = 0;
+#ifdef _WIN32
+            HANDLE m_file = INVALID_HANDLE_VALUE;
+            HANDLE m_mapping = nullptr;
+#endif
+
+          public:
+            explicit MappedFile(const std::string &fileName) {
+#ifdef _WIN32
+                m_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (m_file == INVALID_HANDLE_VALUE) {
+                    Rcpp::stop("Could not open file " + fileName);
+                }
+                LARGE_INTEGER fileSize;
+                if (!GetFileSizeEx(m_file, &fileSize)) {
+                    CloseHandle(m_file);
+                    Rcpp::stop("Could not get the size of file " + fileName);
+                }
+                m_size = static_cast<size_t>(fileSize.QuadPart);
+                if (m_size < sizeof(Header)) {
+                    CloseHandle(m_file);
+                    Rcpp::stop("File " + fileName + " is not a LatticeMap file");
+                }
+                m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                void *data = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+                if (!data) {
+                    if (m_mapping) {
+                        CloseHandle(m_mapping);
+                    }
+                    CloseHandle(m_file);
+                    Rcpp::stop("Could not map file " + fileName + " to memory");
+                }
+                m_data = static_cast<const uint8_t *>(data);
+#else
+                int fd = open(fileName.c_str(), O_RDONLY);
+                if (fd == -1) {
+                    Rcpp::stop("Could not open file " + fileName);
+                }
+                struct stat fileStat;
+                if (fstat(fd, &fileStat) == -1) {
+                    close(fd);
+                    Rcpp::stop("Could not get the size of file " + fileName);
+                }
+                m_size = static_cast<size_t>(fileStat.st_size);
+                if (m_size < sizeof(Header)) {
+                    close(fd);
+                    Rcpp::stop("File " + fileName + " is not a LatticeMap file");
+                }
+                void *data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+                // the mapping is kept after the file is closed
+                close(fd);
+                if (data == MAP_FAILED) {
+                    Rcpp::stop("Could not map file " + fileName + " to memory");
+                }
+                m_data = static_cast<const uint8_t *>(data);
+#endif
+            }
+            ~MappedFile() {
+#ifdef _WIN32
+                UnmapViewOfFile(m_data);
+                CloseHandle(m_mapping);
+                CloseHandle(m_file);
+#else
+                munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+            }
+            MappedFile(const MappedFile &) = delete;
+            MappedFile &operator=(const MappedFile &) = delete;
+
+            const uint8_t *data() const { return m_data; }
+            size_t size() const { return m_size; }
+        };
+
+        // Stream over memory, to let sala read from the mapping directly
+        class MemoryBuffer : public std::streambuf {
+          public:
+            MemoryBuffer(const uint8_t *data, size_t size) {
+                char *begin = const_cast<char *>(reinterpret_cast<const char *>(data));
+                setg(begin, begin, begin + size);
+            }
+        };
+
+        void writePadding(std::ofstream &stream) {
+            static const char zeros[ALIGNMENT] = {};
+            uint64_t position = static_cast<uint64_t>(stream.tellp());
+            stream.write(zeros, static_cast<std::streamsize>(aligned(position) - position));
+        }
+    } // namespace
+
+    void write(const std::string &fileName, LatticeMap &latticeMap,
+               const LatticeGraph::CompressedGraph &graph) {
+        std::ofstream stream(fileName, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            Rcpp::stop("Could not open file " + fileName + " for writing");
+        }
+
+        Header header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.byteOrder = BYTE_ORDER_MARK;
+        header.numCells = graph.size();
+        header.dataSize = graph.getDataSize();
+
+        // the header is written again once the size of the map is known
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+        latticeMap.write(stream);
+        header.mapSize = static_cast<uint64_t>(stream.tellp()) - sizeof(Header);
+        writePadding(stream);
+
+        const size_t numCells = graph.size();
+        stream.write(reinterpret_cast<const char *>(graph.getOffsets()),
+                     static_cast<std::streamsize>((numCells + 1) * sizeof(uint64_t)));
+        stream.write(reinterpret_cast<const char *>(graph.getCells()),
+                     static_cast<std::streamsize>(numCells * sizeof(int)));
+        writePadding(stream);
+        stream.write(reinterpret_cast<const char *>(graph.getData()),
+                     static_cast<std::streamsize>(header.dataSize));
+
+        stream.seekp(0);
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+        if (!stream) {
+            Rcpp::stop("Could not write to file " + fileName);
+        }
+    }
+
+    Contents read(const std::string &fileName) {
+        auto file = std::make_shared<MappedFile>(fileName);
+
+        Header header;
+        std::memcpy(&header, file->data(), sizeof(Header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+            Rcpp::stop("File " + fileName + " is not a LatticeMap file");
+        }
+        if (header.byteOrder != BYTE_ORDER_MARK) {
+            Rcpp::stop("File " + fileName + " was written on a machine of different byte order");
+        }
+        if (header.version != VERSION) {
+            Rcpp::stop("File " + fileName + " is of version " + std::to_string(header.version) +
+                       " while only version " + std::to_string(VERSION) + " can be read");
+        }
+
+        // where each part starts, checked against the size of the file
+        // before anything is read from it
+        const uint64_t fileSize = file->size();
+        const uint64_t mapStart = sizeof(Header);
+        if (header.mapSize > fileSize || header.numCells > fileSize / sizeof(int) ||
+            header.dataSize > fileSize) {
+            Rcpp::stop("File " + fileName + " is truncated or corrupt");
+        }
+        const uint64_t offsetsStart = aligned(mapStart + header.mapSize);
+        const uint64_t cellsStart = offsetsStart + (header.numCells + 1) * sizeof(uint64_t);
+        const uint64_t dataStart = aligned(cellsStart + header.numCells * sizeof(int));
+        if (dataStart + header.dataSize > fileSize) {
+            Rcpp::stop("File " + fileName + " is truncated or corrupt");
+        }
+
+        Contents contents;
+        MemoryBuffer buffer(file->data() + mapStart, header.mapSize);
+        std::istream stream(&buffer);
+        contents.latticeMap = std::make_unique<LatticeMap>(Region4f());
+        contents.latticeMap->read(stream);
+        if (!stream) {
+            Rcpp::stop("Could not read the LatticeMap from file " + fileName);
+        }
+
+        const uint8_t *data = file->data();
+        const auto *offsets = reinterpret_cast<const uint64_t *>(data + offsetsStart);
+        if (offsets[header.numCells] != header.dataSize) {
+            Rcpp::stop("File " + fileName + " is truncated or corrupt");
+        }
+        contents.graph = std::make_unique<LatticeGraph::CompressedGraph>(
+            file, header.numCells, reinterpret_cast<const int *>(data + cellsStart), offsets,
+            data + dataStart);
+        return contents;
+    }
+
+} // namespace LatticeFile
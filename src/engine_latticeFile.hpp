@@ -0,0 +1,39 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// On-disk format of lattice maps with a compressed graph. The file starts
+// with a fixed header (magic, version, byte order and sizes), followed by the
+// lattice map as written by sala (cells, attributes and links, without the
+// nodes since the graph is compressed) and then the arrays of the compressed
+// graph, each aligned to 8 bytes. When read, the file is mapped to memory:
+// the lattice map is parsed from the mapping, while the graph (by far the
+// largest part) is used in place, so reading is quick and the pages of the
+// graph are shared between the processes that read the same file.
+
+#pragma once
+
+#include "salalib/latticemap.hpp"
+
+#include "engine_latticeGraph.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace LatticeFile {
+
+    // raised whenever the layout of the file changes
+    constexpr uint32_t VERSION = 1;
+
+    void write(const std::string &fileName, LatticeMap &latticeMap,
+               const LatticeGraph::CompressedGraph &graph);
+
+    struct Contents {
+        std::unique_ptr<LatticeMap> latticeMap;
+        // holds on to the mapping of the file
+        std::unique_ptr<LatticeGraph::CompressedGraph> graph;
+    };
+    Contents read(const std::string &fileName);
+
+} // namespace LatticeFile
@@ -0,0 +1,207 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_latticeGraph.hpp"
+
+#include "helper_parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <numeric>
+
+namespace LatticeGraph {
+
+    namespace {
+        // cells given to a thread at a time, each block encoded in its own
+        // buffer so that the buffers can be put together in order
+        constexpr size_t BLOCK_SIZE = 1024;
+
+        void writeVarint(std::vector<uint8_t> &data, uint64_t value) {
+            while (value >= 0x80) {
+                data.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            data.push_back(static_cast<uint8_t>(value));
+        }
+
+        // Sorted refs as the gap from the end of the previous run (or 0) and
+        // the length of the run (less one)
+        void encodeRuns(std::vector<uint8_t> &data, const std::vector<int> &refs) {
+            uint64_t next = 0;
+            for (size_t i = 0; i < refs.size();) {
+                size_t last = i;
+                while (last + 1 < refs.size() && refs[last + 1] == refs[last] + 1) {
+                    ++last;
+                }
+                uint64_t start = static_cast<uint64_t>(refs[i]);
+                writeVarint(data, start - next);
+                writeVarint(data, last - i);
+                next = static_cast<uint64_t>(refs[last]) + 1;
+                i = last + 1;
+            }
+        }
+    } // namespace
+
+    CompressedGraph::CompressedGraph(Communicator *comm, LatticeMap &latticeMap, int nthreads) {
+        // columns first, so that the refs are in increasing order
+        for (size_t i = 0; i < latticeMap.getCols(); i++) {
+            for (size_t j = 0; j < latticeMap.getRows(); j++) {
+                PixelRef cell(static_cast<short>(i), static_cast<short>(j));
+                const Point &point = latticeMap.getPoint(cell);
+                if (point.filled() && point.hasNode()) {
+                    m_cellStore.push_back(cell);
+                }
+            }
+        }
+        const size_t numCells = m_cellStore.size();
+        m_offsetStore.assign(numCells + 1, 0);
+        if (comm) {
+            comm->CommPostMessage(Communicator::NUM_RECORDS, numCells);
+        }
+
+        const size_t numBlocks = (numCells + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        std::vector<std::vector<uint8_t>> blockData(numBlocks);
+        nthreads = Parallel::getNumThreads(nthreads, numBlocks);
+        std::atomic<size_t> nextBlock(0);
+        Parallel::forEachThread(nthreads, comm, [&](int, Communicator *threadComm) {
+            PixelRefVector hood;
+            std::vector<int> refs;
+            for (size_t blockIdx = nextBlock++; blockIdx < numBlocks; blockIdx = nextBlock++) {
+                auto &data = blockData[blockIdx];
+                size_t blockEnd = std::min((blockIdx + 1) * BLOCK_SIZE, numCells);
+                for (size_t cellIdx = blockIdx * BLOCK_SIZE; cellIdx < blockEnd; ++cellIdx) {
+                    threadComm->CommPostMessage(Communicator::CURRENT_RECORD, cellIdx);
+                    if (threadComm->IsCancelled()) {
+                        throw Communicator::CancelledException();
+                    }
+                    hood.clear();
+                    latticeMap.getPoint(PixelRef(m_cellStore[cellIdx])).getNode().contents(hood);
+                    refs.assign(hood.begin(), hood.end());
+                    std::sort(refs.begin(), refs.end());
+                    refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+                    size_t start = data.size();
+                    encodeRuns(data, refs);
+                    // the size for now, turned to the offset below
+                    m_offsetStore[cellIdx + 1] = data.size() - start;
+                }
+            }
+        });
+
+        std::partial_sum(m_offsetStore.begin(), m_offsetStore.end(), m_offsetStore.begin());
+        m_dataStore.reserve(m_offsetStore.back());
+        for (auto &data : blockData) {
+            m_dataStore.insert(m_dataStore.end(), data.begin(), data.end());
+            std::vector<uint8_t>().swap(data);
+        }
+
+        m_size = numCells;
+        m_cells = m_cellStore.data();
+        m_offsets = m_offsetStore.data();
+        m_data = m_dataStore.data();
+    }
+
+    int CompressedGraph::getCellIndex(PixelRef cell) const {
+        const int *end = m_cells + m_size;
+        const int *it = std::lower_bound(m_cells, end, static_cast<int>(cell));
+        if (it == end || *it != static_cast<int>(cell)) {
+            return -1;
+        }
+        return static_cast<int>(it - m_cells);
+    }
+
+    size_t CompressedGraph::getNumNeighbours(size_t cellIdx) const {
+        const uint8_t *data = m_data + m_offsets[cellIdx];
+        const uint8_t *end = m_data + m_offsets[cellIdx + 1];
+        size_t numNeighbours = 0;
+        while (data < end) {
+            readVarint(data);
+            numNeighbours += readVarint(data) + 1;
+        }
+        return numNeighbours;
+    }
+
+    AnalysisResult runVisualDepth(Communicator *comm, LatticeMap &latticeMap,
+                                  const CompressedGraph &graph, const std::set<PixelRef> &origins) {
+        const size_t rows = latticeMap.getRows();
+        auto getGridIdx = [rows](PixelRef cell) {
+            return static_cast<size_t>(cell.x) * rows + static_cast<size_t>(cell.y);
+        };
+
+        std::map<int, std::vector<PixelRef>> links;
+        for (const auto &link : latticeMap.getMergedPixelPairs()) {
+            links[link.first].push_back(link.second);
+            links[link.second].push_back(link.first);
+        }
+
+        if (comm) {
+            comm->CommPostMessage(Communicator::NUM_RECORDS, latticeMap.getFilledPointCount());
+        }
+
+        std::vector<float> depths(rows * latticeMap.getCols(), -1.0f);
+        std::vector<PixelRef> currentLevel(origins.begin(), origins.end()), nextLevel;
+        for (PixelRef origin : origins) {
+            depths[getGridIdx(origin)] = 0;
+        }
+        size_t numReached = origins.size();
+        float depth = 0;
+        while (!currentLevel.empty()) {
+            depth++;
+            nextLevel.clear();
+            auto reach = [&](PixelRef cell) {
+                float &cellDepth = depths[getGridIdx(cell)];
+                if (cellDepth == -1.0f) {
+                    cellDepth = depth;
+                    nextLevel.push_back(cell);
+                }
+            };
+            // as in sala, the cells linked to a cell are at its depth and
+            // their neighbours are reached along with its own
+            for (size_t i = 0; i < currentLevel.size(); ++i) {
+                PixelRef cell = currentLevel[i];
+                auto linkIt = links.find(cell);
+                if (linkIt != links.end()) {
+                    for (PixelRef linkedCell : linkIt->second) {
+                        float &linkedDepth = depths[getGridIdx(linkedCell)];
+                        if (linkedDepth == -1.0f || linkedDepth > depth - 1) {
+                            numReached += linkedDepth == -1.0f ? 1 : 0;
+                            linkedDepth = depth - 1;
+                            currentLevel.push_back(linkedCell);
+                        }
+                    }
+                }
+                int cellIdx = graph.getCellIndex(cell);
+                if (cellIdx != -1) {
+                    graph.forEachNeighbour(cellIdx, reach);
+                }
+            }
+            numReached += nextLevel.size();
+            if (comm) {
+                if (comm->IsCancelled()) {
+                    throw Communicator::CancelledException();
+                }
+                comm->CommPostMessage(Communicator::CURRENT_RECORD, numReached);
+            }
+            std::swap(currentLevel, nextLevel);
+        }
+
+        const std::string colName = "Visual Step Depth";
+        AttributeTable &table = latticeMap.getAttributeTable();
+        int colIdx = table.getOrInsertColumn(colName);
+        for (size_t i = 0; i < latticeMap.getCols(); i++) {
+            for (size_t j = 0; j < rows; j++) {
+                PixelRef cell(static_cast<short>(i), static_cast<short>(j));
+                if (latticeMap.getPoint(cell).filled()) {
+                    table.getRow(AttributeKey(cell)).setValue(colIdx, depths[getGridIdx(cell)]);
+                }
+            }
+        }
+
+        AnalysisResult result;
+        result.addAttribute(colName);
+        result.completed = true;
+        return result;
+    }
+
+} // namespace LatticeGraph
@@ -0,0 +1,110 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Compressed visibility graph of lattice maps. The cells that each cell sees
+// are taken from its node as refs (column in the high and row in the low 16
+// bits), which sorted fall in runs along the columns of the grid. Each run is
+// kept as the gap from the end of the previous run and its length, both as
+// variable-length integers (7 bits a byte), so that an open space of n cells
+// that see each other takes a few bytes per column instead of 4 bytes per
+// pair. The neighbourhoods are decoded on the fly while traversing, and the
+// nodes of sala can then be released (by unmaking the graph).
+
+#pragma once
+
+#include "salalib/analysisresult.hpp"
+#include "salalib/latticemap.hpp"
+
+#include "communicator.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace LatticeGraph {
+
+    class CompressedGraph {
+        // Storage of the graph, when encoded here. The graph is otherwise
+        // read in place from memory kept alive by m_source (e.g. a file
+        // mapped by LatticeFile)
+        std::vector<int> m_cellStore;
+        std::vector<uint64_t> m_offsetStore;
+        std::vector<uint8_t> m_dataStore;
+        std::shared_ptr<const void> m_source;
+
+        size_t m_size = 0;
+        // refs of the cells that have a node, in increasing order
+        const int *m_cells = nullptr;
+        // start of the neighbourhood of every cell in m_data, and the end
+        const uint64_t *m_offsets = nullptr;
+        const uint8_t *m_data = nullptr;
+
+        static uint64_t readVarint(const uint8_t *&data) {
+            uint64_t value = 0;
+            int shift = 0;
+            while (*data & 0x80) {
+                value |= static_cast<uint64_t>(*data++ & 0x7f) << shift;
+                shift += 7;
+            }
+            value |= static_cast<uint64_t>(*data++) << shift;
+            return value;
+        }
+
+      public:
+        CompressedGraph() = default;
+        // Encodes the nodes of a lattice map that has its graph made, each
+        // thread a block of cells at a time
+        CompressedGraph(Communicator *comm, LatticeMap &latticeMap, int nthreads);
+        // Uses the arrays (size cells, size + 1 offsets and the data they
+        // point to) where they are, as long as the source is kept
+        CompressedGraph(std::shared_ptr<const void> source, size_t size, const int *cells,
+                        const uint64_t *offsets, const uint8_t *data)
+            : m_source(std::move(source)), m_size(size), m_cells(cells), m_offsets(offsets),
+              m_data(data) {}
+        // the arrays may point into the object itself
+        CompressedGraph(const CompressedGraph &) = delete;
+        CompressedGraph &operator=(const CompressedGraph &) = delete;
+
+        size_t size() const { return m_size; }
+        const int *getCells() const { return m_cells; }
+        const uint64_t *getOffsets() const { return m_offsets; }
+        const uint8_t *getData() const { return m_data; }
+        size_t getDataSize() const { return m_size == 0 ? 0 : m_offsets[m_size]; }
+        PixelRef getCell(size_t cellIdx) const { return PixelRef(m_cells[cellIdx]); }
+        // Index of the cell with the ref, or -1 if the cell has no node
+        int getCellIndex(PixelRef cell) const;
+        size_t getNumNeighbours(size_t cellIdx) const;
+        // Bytes held by the graph, for comparison with the nodes. Memory
+        // held by the source is not counted
+        size_t getMemoryUsage() const {
+            return m_cellStore.capacity() * sizeof(int) +
+                   m_offsetStore.capacity() * sizeof(uint64_t) + m_dataStore.capacity();
+        }
+
+        // Calls func(PixelRef) for every cell the cell sees, in increasing
+        // order of ref
+        template <class F> void forEachNeighbour(size_t cellIdx, F &&func) const {
+            const uint8_t *data = m_data + m_offsets[cellIdx];
+            const uint8_t *end = m_data + m_offsets[cellIdx + 1];
+            uint64_t next = 0;
+            while (data < end) {
+                uint64_t start = next + readVarint(data);
+                uint64_t last = start + readVarint(data);
+                for (uint64_t ref = start; ref <= last; ++ref) {
+                    func(PixelRef(static_cast<int>(ref)));
+                }
+                next = last + 1;
+            }
+        }
+    };
+
+    // Visual step depth from the origins over the compressed graph, in the
+    // "Visual Step Depth" column. Linked cells are at the same depth, as in
+    // sala. Cells that can not be reached are given -1
+    AnalysisResult runVisualDepth(Communicator *comm, LatticeMap &latticeMap,
+                                  const CompressedGraph &graph, const std::set<PixelRef> &origins);
+
+} // namespace LatticeGraph
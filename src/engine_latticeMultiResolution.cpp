@@ -0,0 +1,336 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_latticeMultiResolution.hpp"
+
+#include "helper_parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+
+namespace LatticeMultiResolution {
+
+    namespace {
+        // tolerance of a line going through the corner of a cell, in cells
+        constexpr double CORNER_TOLERANCE = 1e-9;
+
+        // as sala's D-value, to normalise the relative asymmetry of a graph
+        // of n nodes
+        double dvalue(double n) {
+            return 2.0 * (n * (std::log2((n + 2.0) / 3.0) - 1.0) + 1.0) / ((n - 1.0) * (n - 2.0));
+        }
+
+        // Whether the line between the centres of the blocks only crosses
+        // clear cells, walking the cells along it (Amanatides and Woo). At a
+        // corner both cells beside it have to be clear
+        bool blocksSee(const Block &from, const Block &to, const std::vector<uint8_t> &clearCells,
+                       int cols, int rows) {
+            auto isClear = [&clearCells, cols, rows](int x, int y) {
+                return x >= 0 && y >= 0 && x < cols && y < rows &&
+                       clearCells[static_cast<size_t>(x) * rows + static_cast<size_t>(y)];
+            };
+            const double startX = from.x + from.size * 0.5, startY = from.y + from.size * 0.5;
+            const double endX = to.x + to.size * 0.5, endY = to.y + to.size * 0.5;
+            const double dx = endX - startX, dy = endY - startY;
+            const int targetX = static_cast<int>(std::floor(endX));
+            const int targetY = static_cast<int>(std::floor(endY));
+            int x = static_cast<int>(std::floor(startX)), y = static_cast<int>(std::floor(startY));
+
+            const double inf = std::numeric_limits<double>::infinity();
+            const int stepX = dx > 0 ? 1 : (dx < 0 ? -1 : 0);
+            const int stepY = dy > 0 ? 1 : (dy < 0 ? -1 : 0);
+            const double deltaX = stepX != 0 ? 1.0 / std::abs(dx) : inf;
+            const double deltaY = stepY != 0 ? 1.0 / std::abs(dy) : inf;
+            // distance along the line (0 to 1) to the next column and row
+            double nextX = stepX > 0 ? (x + 1 - startX) * deltaX
+                                     : (stepX < 0 ? (startX - x) * deltaX : inf);
+            double nextY = stepY > 0 ? (y + 1 - startY) * deltaY
+                                     : (stepY < 0 ? (startY - y) * deltaY : inf);
+
+            while ((x != targetX || y != targetY) && std::min(nextX, nextY) <= 1.0) {
+                if (std::abs(nextX - nextY) < CORNER_TOLERANCE) {
+                    if (!isClear(x + stepX, y) || !isClear(x, y + stepY)) {
+                        return false;
+                    }
+                    x += stepX;
+                    y += stepY;
+                    nextX += deltaX;
+                    nextY += deltaY;
+                } else if (nextX < nextY) {
+                    x += stepX;
+                    nextX += deltaX;
+                } else {
+                    y += stepY;
+                    nextY += deltaY;
+                }
+                if (!isClear(x, y)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    } // namespace
+
+    Blocks makeBlocks(LatticeMap &latticeMap, int maxLevel) {
+        const int cols = static_cast<int>(latticeMap.getCols());
+        const int rows = static_cast<int>(latticeMap.getRows());
+
+        // Number of open cells below and to the left of every corner of the
+        // grid, to count those of any square at once
+        std::vector<int> openCounts(static_cast<size_t>(cols + 1) * (rows + 1), 0);
+        auto getCountIdx = [rows](int x, int y) {
+            return static_cast<size_t>(x) * (rows + 1) + static_cast<size_t>(y);
+        };
+        for (int x = 0; x < cols; x++) {
+            for (int y = 0; y < rows; y++) {
+                const Point &point =
+                    latticeMap.getPoint(PixelRef(static_cast<short>(x), static_cast<short>(y)));
+                int open = point.filled() && !point.blocked() && !point.edge() ? 1 : 0;
+                openCounts[getCountIdx(x + 1, y + 1)] = open + openCounts[getCountIdx(x, y + 1)] +
+                                                        openCounts[getCountIdx(x + 1, y)] -
+                                                        openCounts[getCountIdx(x, y)];
+            }
+        }
+        // the square and the ring of cells around it, which has to be in the
+        // grid, are all open
+        auto isOpen = [&](const Block &square) {
+            int fromX = square.x - 1, fromY = square.y - 1;
+            int toX = square.x + square.size + 1, toY = square.y + square.size + 1;
+            if (fromX < 0 || fromY < 0 || toX > cols || toY > rows) {
+                return false;
+            }
+            int count = openCounts[getCountIdx(toX, toY)] - openCounts[getCountIdx(fromX, toY)] -
+                        openCounts[getCountIdx(toX, fromY)] + openCounts[getCountIdx(fromX, fromY)];
+            return count == (square.size + 2) * (square.size + 2);
+        };
+
+        Blocks result;
+        result.cellBlocks.assign(static_cast<size_t>(cols) * rows, -1);
+        const int topSize = 1 << maxLevel;
+        // squares still to be placed, taken depth first so that the blocks
+        // follow the quadtree
+        std::vector<Block> squares;
+        for (int x = 0; x < cols; x += topSize) {
+            for (int y = 0; y < rows; y += topSize) {
+                squares.push_back({x, y, topSize});
+                while (!squares.empty()) {
+                    Block square = squares.back();
+                    squares.pop_back();
+                    if (square.x >= cols || square.y >= rows) {
+                        continue;
+                    }
+                    if (square.size == 1) {
+                        if (!latticeMap
+                                 .getPoint(PixelRef(static_cast<short>(square.x),
+                                                    static_cast<short>(square.y)))
+                                 .filled()) {
+                            continue;
+                        }
+                    } else if (!isOpen(square)) {
+                        int half = square.size / 2;
+                        // in reverse, so that they are taken in order
+                        squares.push_back({square.x + half, square.y + half, half});
+                        squares.push_back({square.x + half, square.y, half});
+                        squares.push_back({square.x, square.y + half, half});
+                        squares.push_back({square.x, square.y, half});
+                        continue;
+                    }
+                    int blockIdx = static_cast<int>(result.blocks.size());
+                    result.blocks.push_back(square);
+                    for (int i = square.x; i < square.x + square.size; i++) {
+                        for (int j = square.y; j < square.y + square.size; j++) {
+                            result.cellBlocks[static_cast<size_t>(i) * rows + j] = blockIdx;
+                        }
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    AnalysisResult runVisualGlobal(Communicator *comm, LatticeMap &latticeMap, int maxLevel,
+                                   int nthreads) {
+        const int cols = static_cast<int>(latticeMap.getCols());
+        const int rows = static_cast<int>(latticeMap.getRows());
+        Blocks blocks = makeBlocks(latticeMap, maxLevel);
+        const size_t numBlocks = blocks.blocks.size();
+
+        std::vector<uint8_t> clearCells(static_cast<size_t>(cols) * rows, 0);
+        for (int x = 0; x < cols; x++) {
+            for (int y = 0; y < rows; y++) {
+                const Point &point =
+                    latticeMap.getPoint(PixelRef(static_cast<short>(x), static_cast<short>(y)));
+                clearCells[static_cast<size_t>(x) * rows + y] = point.filled() && !point.blocked();
+            }
+        }
+        std::vector<double> areas;
+        areas.reserve(numBlocks);
+        for (const auto &block : blocks.blocks) {
+            areas.push_back(static_cast<double>(block.size) * block.size);
+        }
+
+        // the blocks of the cells linked to each other, which are at the same
+        // depth as in sala
+        std::vector<std::vector<int>> linkedBlocks(numBlocks);
+        for (const auto &link : latticeMap.getMergedPixelPairs()) {
+            int fromBlock =
+                blocks.cellBlocks[static_cast<size_t>(link.first.x) * rows + link.first.y];
+            int toBlock =
+                blocks.cellBlocks[static_cast<size_t>(link.second.x) * rows + link.second.y];
+            if (fromBlock != -1 && toBlock != -1 && fromBlock != toBlock) {
+                linkedBlocks[fromBlock].push_back(toBlock);
+                linkedBlocks[toBlock].push_back(fromBlock);
+            }
+        }
+
+        if (comm) {
+            // the visibility of the blocks, and then their depths
+            comm->CommPostMessage(Communicator::NUM_RECORDS, numBlocks * 2);
+        }
+        nthreads = Parallel::getNumThreads(nthreads, numBlocks);
+
+        // Every block only keeps the blocks after it that it sees, so that
+        // each pair is tested once
+        std::vector<std::vector<int>> laterBlocks(numBlocks);
+        std::atomic<size_t> nextBlock(0);
+        Parallel::forEachThread(nthreads, comm, [&](int, Communicator *threadComm) {
+            for (size_t blockIdx = nextBlock++; blockIdx < numBlocks; blockIdx = nextBlock++) {
+                threadComm->CommPostMessage(Communicator::CURRENT_RECORD, blockIdx);
+                if (threadComm->IsCancelled()) {
+                    throw Communicator::CancelledException();
+                }
+                const Block &block = blocks.blocks[blockIdx];
+                for (size_t other = blockIdx + 1; other < numBlocks; ++other) {
+                    if (blocksSee(block, blocks.blocks[other], clearCells, cols, rows)) {
+                        laterBlocks[blockIdx].push_back(static_cast<int>(other));
+                    }
+                }
+            }
+        });
+
+        // the graph of the blocks as the offsets of the blocks each block
+        // sees in the targets
+        std::vector<size_t> offsets(numBlocks + 1, 0);
+        for (size_t blockIdx = 0; blockIdx < numBlocks; ++blockIdx) {
+            offsets[blockIdx + 1] += laterBlocks[blockIdx].size();
+            for (int other : laterBlocks[blockIdx]) {
+                offsets[other + 1]++;
+            }
+        }
+        for (size_t blockIdx = 0; blockIdx < numBlocks; ++blockIdx) {
+            offsets[blockIdx + 1] += offsets[blockIdx];
+        }
+        std::vector<int> targets(offsets.back());
+        {
+            std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_t blockIdx = 0; blockIdx < numBlocks; ++blockIdx) {
+                for (int other : laterBlocks[blockIdx]) {
+                    targets[cursor[blockIdx]++] = other;
+                    targets[cursor[other]++] = static_cast<int>(blockIdx);
+                }
+                std::vector<int>().swap(laterBlocks[blockIdx]);
+            }
+        }
+
+        // Each block counts its own other cells as seen (at depth 1) and the
+        // cells of every other block at the depth of the block
+        std::vector<double> connectivity(numBlocks), nodeCounts(numBlocks),
+            meanDepths(numBlocks, -1.0), integrations(numBlocks, -1.0);
+        nextBlock = 0;
+        Parallel::forEachThread(nthreads, comm, [&](int, Communicator *threadComm) {
+            std::vector<int> depths(numBlocks, -1);
+            std::vector<int> reached;
+            for (size_t blockIdx = nextBlock++; blockIdx < numBlocks; blockIdx = nextBlock++) {
+                threadComm->CommPostMessage(Communicator::CURRENT_RECORD, numBlocks + blockIdx);
+                if (threadComm->IsCancelled()) {
+                    throw Communicator::CancelledException();
+                }
+                double seenArea = areas[blockIdx] - 1.0;
+                for (size_t t = offsets[blockIdx]; t < offsets[blockIdx + 1]; ++t) {
+                    seenArea += areas[targets[t]];
+                }
+                connectivity[blockIdx] = seenArea;
+
+                double nodeCount = 0;
+                double totalDepth = 0;
+                // the block and those linked to it (in turn) at the depth
+                auto reach = [&](int block, int depth) {
+                    size_t first = reached.size();
+                    depths[block] = depth;
+                    reached.push_back(block);
+                    for (size_t current = first; current < reached.size(); ++current) {
+                        for (int linked : linkedBlocks[reached[current]]) {
+                            if (depths[linked] == -1) {
+                                depths[linked] = depth;
+                                reached.push_back(linked);
+                            }
+                        }
+                    }
+                    for (size_t current = first; current < reached.size(); ++current) {
+                        nodeCount += areas[reached[current]];
+                        totalDepth += areas[reached[current]] * depth;
+                    }
+                };
+                reached.clear();
+                reach(static_cast<int>(blockIdx), 0);
+                totalDepth += areas[blockIdx] - 1.0;
+                for (size_t current = 0; current < reached.size(); ++current) {
+                    int block = reached[current];
+                    for (size_t t = offsets[block]; t < offsets[block + 1]; ++t) {
+                        int other = targets[t];
+                        if (depths[other] == -1) {
+                            reach(other, depths[block] + 1);
+                        }
+                    }
+                }
+                for (int block : reached) {
+                    depths[block] = -1;
+                }
+
+                nodeCounts[blockIdx] = nodeCount;
+                if (nodeCount > 1) {
+                    double meanDepth = totalDepth / (nodeCount - 1.0);
+                    meanDepths[blockIdx] = meanDepth;
+                    if (nodeCount > 2 && meanDepth > 1.0) {
+                        double relativeAsymmetry = 2.0 * (meanDepth - 1.0) / (nodeCount - 2.0);
+                        integrations[blockIdx] = dvalue(nodeCount) / relativeAsymmetry;
+                    }
+                }
+            }
+        });
+
+        const std::vector<std::pair<std::string, std::vector<double> *>> columns = {
+            {"Multi-Resolution Block Size", nullptr},
+            {"Multi-Resolution Visual Connectivity", &connectivity},
+            {"Multi-Resolution Visual Integration [HH]", &integrations},
+            {"Multi-Resolution Visual Mean Depth", &meanDepths},
+            {"Multi-Resolution Visual Node Count", &nodeCounts}};
+        AnalysisResult result;
+        AttributeTable &table = latticeMap.getAttributeTable();
+        for (const auto &column : columns) {
+            int colIdx = table.getOrInsertColumn(column.first);
+            for (int x = 0; x < cols; x++) {
+                for (int y = 0; y < rows; y++) {
+                    int blockIdx = blocks.cellBlocks[static_cast<size_t>(x) * rows + y];
+                    if (blockIdx == -1) {
+                        continue;
+                    }
+                    double value = column.second ? (*column.second)[blockIdx]
+                                                 : blocks.blocks[blockIdx].size;
+                    table.getRow(AttributeKey(PixelRef(static_cast<short>(x), static_cast<short>(y))))
+                        .setValue(colIdx, static_cast<float>(value));
+                }
+            }
+            result.addAttribute(column.first);
+        }
+        result.completed = true;
+        return result;
+    }
+
+} // namespace LatticeMultiResolution
@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Multi-resolution visibility graph analysis of lattice maps. The filled
+// cells are grouped in square blocks of a quadtree over the grid: a block of
+// 2^k by 2^k cells is kept whole if all its cells, and the ring of cells
+// around it, are filled, not blocked and not on an edge, and is otherwise
+// split in four, down to single cells. Open space is thus covered by few
+// large blocks while the cells near the boundaries stay as they are. Blocks
+// see each other if the line between their centres only crosses filled and
+// unblocked cells, and the measures are weighted by the area (number of
+// cells) of the blocks, so that they approximate those of the full grid with
+// far fewer pairs of cells to test and traverse. The blocks of linked cells
+// are at the same depth, as the cells are in sala.
+
+#pragma once
+
+#include "salalib/analysisresult.hpp"
+#include "salalib/latticemap.hpp"
+
+#include "communicator.hpp"
+
+#include <vector>
+
+namespace LatticeMultiResolution {
+
+    struct Block {
+        // the cell at the lower left corner and the side in cells
+        int x, y, size;
+    };
+
+    struct Blocks {
+        std::vector<Block> blocks;
+        // block of every cell, column by column, -1 if the cell is not filled
+        std::vector<int> cellBlocks;
+    };
+
+    // Blocks of at most 2^maxLevel cells on each side
+    Blocks makeBlocks(LatticeMap &latticeMap, int maxLevel);
+
+    // Area-weighted visual connectivity, node count, mean depth and
+    // integration of every block, given to all of its cells. The size of the
+    // blocks is given as well
+    AnalysisResult runVisualGlobal(Communicator *comm, LatticeMap &latticeMap, int maxLevel,
+                                   int nthreads);
+
+} // namespace LatticeMultiResolution
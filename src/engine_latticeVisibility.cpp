@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_latticeVisibility.hpp"
+
+#include "helper_parallel.hpp"
+
+#include <atomic>
+#include <vector>
+
+namespace LatticeVisibility {
+
+    void makeGraph(Communicator *comm, LatticeMap &latticeMap, bool boundaryGraph,
+                   double maxDistance, int nthreads) {
+        // Half a cell is less than the distance to any other cell, so this
+        // only makes the nodes and the columns, leaving the sweeps for below
+        latticeMap.sparkGraph2(nullptr, boundaryGraph, latticeMap.getSpacing() * 0.5);
+
+        // the cells that sala gave a node to, in the order it visits them
+        auto &points = latticeMap.getPoints();
+        std::vector<PixelRef> cells;
+        for (size_t i = 0; i < points.columns(); i++) {
+            for (size_t j = 0; j < points.rows(); j++) {
+                const Point &point = points(j, i);
+                if (point.filled() && point.hasNode()) {
+                    cells.emplace_back(static_cast<short>(i), static_cast<short>(j));
+                }
+            }
+        }
+        const size_t numCells = cells.size();
+        if (comm) {
+            comm->CommPostMessage(Communicator::NUM_RECORDS, numCells);
+        }
+
+        nthreads = Parallel::getNumThreads(nthreads, numCells);
+        std::atomic<size_t> nextCell(0);
+        Parallel::forEachThread(nthreads, comm, [&](int, Communicator *threadComm) {
+            for (size_t cellIdx = nextCell++; cellIdx < numCells; cellIdx = nextCell++) {
+                threadComm->CommPostMessage(Communicator::CURRENT_RECORD, cellIdx);
+                if (threadComm->IsCancelled()) {
+                    throw Communicator::CancelledException();
+                }
+                // 1 to make the node of the cell, without marking the cells
+                // it sees (which belong to other threads)
+                latticeMap.sparkPixel2(cells[cellIdx], 1, maxDistance);
+            }
+        });
+    }
+
+} // namespace LatticeVisibility
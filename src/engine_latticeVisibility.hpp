@@ -0,0 +1,26 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Multi-threaded visibility graph of lattice maps. sala first lays out the
+// graph (the attribute columns and an empty node for every cell that takes
+// part in it) with sight limited to less than a cell, so that no sweep goes
+// further than the cell itself. The visibility sweep of every cell is then
+// run again with the actual limit, by the thread that takes the cell. A sweep
+// only reads the blocked lines of the map and writes the bins of the node and
+// the attribute row of its own cell, so the threads share nothing that is
+// written to, and the graph is the same as the one made by sala on one thread.
+
+#pragma once
+
+#include "salalib/latticemap.hpp"
+
+#include "communicator.hpp"
+
+namespace LatticeVisibility {
+
+    // Equivalent of sala's LatticeMap::sparkGraph2
+    void makeGraph(Communicator *comm, LatticeMap &latticeMap, bool boundaryGraph,
+                   double maxDistance, int nthreads);
+
+} // namespace LatticeVisibility
@@ -0,0 +1,340 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_segmentConversion.hpp"
+
+#include "helper_parallel.hpp"
+
+#include <Rcpp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+
+namespace SegmentConversion {
+
+    namespace {
+        constexpr double PI = 3.14159265358979323846;
+
+        // tolerance of the positions of junctions, relative to the size of
+        // the map
+        constexpr double RELATIVE_TOLERANCE = 1e-6;
+
+        // A point where two axial lines meet, at position t (0 at the start
+        // and 1 at the end) along one of them
+        struct Stop {
+            double t;
+            int junction;
+        };
+
+        // A piece of an axial line between two junctions (or a junction and
+        // an end of the line), with the junctions at either of its ends
+        struct Piece {
+            Line4f line;
+            std::vector<int> startJunctions, endJunctions;
+        };
+
+        // One end of a segment, 0 for its start and 1 for its end
+        struct SegmentEnd {
+            size_t segment;
+            int end;
+        };
+
+        // The positions along a and b where the two lines meet, if they do
+        // (within the tolerance)
+        bool getJunction(const Line4f &a, const Line4f &b, double tolerance, double &tA,
+                         double &tB) {
+            double rx = a.end().x - a.start().x, ry = a.end().y - a.start().y;
+            double sx = b.end().x - b.start().x, sy = b.end().y - b.start().y;
+            double denominator = rx * sy - ry * sx;
+            double lengthA = std::hypot(rx, ry), lengthB = std::hypot(sx, sy);
+            // parallel (or overlapping) lines do not make junctions
+            if (lengthA == 0 || lengthB == 0 ||
+                std::abs(denominator) <= 1e-12 * lengthA * lengthB) {
+                return false;
+            }
+            double qx = b.start().x - a.start().x, qy = b.start().y - a.start().y;
+            tA = (qx * sy - qy * sx) / denominator;
+            tB = (qx * ry - qy * rx) / denominator;
+            auto outside = [](double t, double length) {
+                return (t < 0 ? -t : (t > 1 ? t - 1 : 0)) * length;
+            };
+            if (outside(tA, lengthA) > tolerance || outside(tB, lengthB) > tolerance) {
+                // e.g. a link between lines that do not meet
+                return false;
+            }
+            tA = std::clamp(tA, 0.0, 1.0);
+            tB = std::clamp(tB, 0.0, 1.0);
+            return true;
+        }
+
+        // Splits the line at its stops and removes the stubs
+        std::vector<Piece> splitLine(const Line4f &line, std::vector<Stop> stops,
+                                     double tolerance, double stubRemoval) {
+            const double length = line.length();
+            const double tTolerance = length > 0 ? tolerance / length : 1;
+            std::sort(stops.begin(), stops.end(), [](const Stop &a, const Stop &b) {
+                return a.t < b.t || (a.t == b.t && a.junction < b.junction);
+            });
+
+            // positions along the line where it is split, with the junctions
+            // there. Stops closer than the tolerance are taken to be one
+            std::vector<std::pair<double, std::vector<int>>> cuts;
+            cuts.emplace_back(0.0, std::vector<int>());
+            for (const auto &stop : stops) {
+                if (stop.t - cuts.back().first > tTolerance) {
+                    cuts.emplace_back(stop.t, std::vector<int>());
+                }
+                cuts.back().second.push_back(stop.junction);
+            }
+            if (1.0 - cuts.back().first > tTolerance) {
+                cuts.emplace_back(1.0, std::vector<int>());
+            } else {
+                cuts.back().first = 1.0;
+            }
+
+            auto pointAt = [&line](double t) {
+                return Point2f(line.start().x + t * (line.end().x - line.start().x),
+                               line.start().y + t * (line.end().y - line.start().y));
+            };
+            std::vector<Piece> pieces;
+            for (size_t i = 0; i + 1 < cuts.size(); ++i) {
+                pieces.push_back(Piece{Line4f(pointAt(cuts[i].first), pointAt(cuts[i + 1].first)),
+                                       cuts[i].second, cuts[i + 1].second});
+            }
+            if (pieces.empty()) {
+                // a line of (almost) no length
+                pieces.push_back(Piece{line, cuts.front().second, cuts.front().second});
+                return pieces;
+            }
+
+            auto isStub = [&](const Piece &piece, const std::vector<int> &freeEnd) {
+                return pieces.size() > 1 && freeEnd.empty() &&
+                       piece.line.length() < stubRemoval * length;
+            };
+            if (isStub(pieces.back(), pieces.back().endJunctions)) {
+                pieces.pop_back();
+            }
+            if (isStub(pieces.front(), pieces.front().startJunctions)) {
+                pieces.erase(pieces.begin());
+            }
+            return pieces;
+        }
+    } // namespace
+
+    std::unique_ptr<ShapeGraph> convertAxialToSegment(Communicator *comm, ShapeGraph &axialMap,
+                                                      const std::string &name, bool copydata,
+                                                      double stubRemoval, int nthreads) {
+        const auto &shapes = axialMap.getAllShapes();
+        const auto &axialConnectors = axialMap.getConnections();
+        if (axialConnectors.size() != shapes.size()) {
+            Rcpp::stop("Axial graph connections (%d) do not match its shapes (%d)",
+                       axialConnectors.size(), shapes.size());
+        }
+        const size_t numLines = shapes.size();
+        std::vector<Line4f> lines;
+        std::vector<int> axialRefs;
+        lines.reserve(numLines);
+        axialRefs.reserve(numLines);
+        for (const auto &shape : shapes) {
+            lines.push_back(shape.second.getLine());
+            axialRefs.push_back(shape.first);
+        }
+        const Region4f &region = axialMap.getRegion();
+        const double tolerance = RELATIVE_TOLERANCE * std::max(region.width(), region.height());
+
+        if (comm) {
+            comm->CommPostMessage(Communicator::NUM_RECORDS, numLines);
+        }
+        nthreads = Parallel::getNumThreads(nthreads, numLines);
+
+        // The junctions of each line with the lines after it
+        struct Crossing {
+            int other;
+            double t, otherT;
+        };
+        std::vector<std::vector<Crossing>> crossings(numLines);
+        std::atomic<size_t> nextLine(0);
+        Parallel::forEachThread(nthreads, comm, [&](int, Communicator *threadComm) {
+            for (size_t lineIdx = nextLine++; lineIdx < numLines; lineIdx = nextLine++) {
+                threadComm->CommPostMessage(Communicator::CURRENT_RECORD, lineIdx);
+                if (threadComm->IsCancelled()) {
+                    throw Communicator::CancelledException();
+                }
+                for (int other : axialConnectors[lineIdx].connections) {
+                    if (other <= static_cast<int>(lineIdx)) {
+                        continue;
+                    }
+                    double t, otherT;
+                    if (getJunction(lines[lineIdx], lines[other], tolerance, t, otherT)) {
+                        crossings[lineIdx].push_back(Crossing{other, t, otherT});
+                    }
+                }
+            }
+        });
+
+        // junctions are numbered in the order of the lines
+        std::vector<std::vector<Stop>> lineStops(numLines);
+        int numJunctions = 0;
+        for (size_t lineIdx = 0; lineIdx < numLines; ++lineIdx) {
+            for (const auto &crossing : crossings[lineIdx]) {
+                lineStops[lineIdx].push_back(Stop{crossing.t, numJunctions});
+                lineStops[crossing.other].push_back(Stop{crossing.otherT, numJunctions});
+                numJunctions++;
+            }
+        }
+        crossings.clear();
+
+        std::vector<std::vector<Piece>> linePieces(numLines);
+        nextLine = 0;
+        Parallel::forEachThread(nthreads, comm, [&](int, Communicator *threadComm) {
+            for (size_t lineIdx = nextLine++; lineIdx < numLines; lineIdx = nextLine++) {
+                if (threadComm->IsCancelled()) {
+                    throw Communicator::CancelledException();
+                }
+                linePieces[lineIdx] =
+                    splitLine(lines[lineIdx], lineStops[lineIdx], tolerance, stubRemoval);
+            }
+        });
+
+        // segments are numbered in the order of the lines, and listed at
+        // the junctions at their ends
+        std::vector<Piece> segments;
+        std::vector<size_t> segmentLines;
+        std::vector<size_t> junctionOffsets(numJunctions + 1, 0);
+        for (size_t lineIdx = 0; lineIdx < numLines; ++lineIdx) {
+            for (auto &piece : linePieces[lineIdx]) {
+                for (int junction : piece.startJunctions) {
+                    junctionOffsets[junction + 1]++;
+                }
+                for (int junction : piece.endJunctions) {
+                    junctionOffsets[junction + 1]++;
+                }
+                segments.push_back(std::move(piece));
+                segmentLines.push_back(lineIdx);
+            }
+        }
+        linePieces.clear();
+        std::partial_sum(junctionOffsets.begin(), junctionOffsets.end(), junctionOffsets.begin());
+        std::vector<SegmentEnd> junctionEnds(junctionOffsets.back());
+        {
+            std::vector<size_t> cursor(junctionOffsets.begin(), junctionOffsets.end() - 1);
+            for (size_t segIdx = 0; segIdx < segments.size(); ++segIdx) {
+                for (int junction : segments[segIdx].startJunctions) {
+                    junctionEnds[cursor[junction]++] = SegmentEnd{segIdx, 0};
+                }
+                for (int junction : segments[segIdx].endJunctions) {
+                    junctionEnds[cursor[junction]++] = SegmentEnd{segIdx, 1};
+                }
+            }
+        }
+
+        // Every segment is connected, by the thread that takes it, to the
+        // other segments at the junctions at its ends
+        const size_t numSegments = segments.size();
+        std::vector<Connector> segmentConnectors(numSegments);
+        auto getDirection = [&segments](size_t segIdx) {
+            const auto &line = segments[segIdx].line;
+            double dx = line.end().x - line.start().x, dy = line.end().y - line.start().y;
+            double length = std::hypot(dx, dy);
+            return length > 0 ? std::make_pair(dx / length, dy / length) : std::make_pair(0.0, 0.0);
+        };
+        std::atomic<size_t> nextSegment(0);
+        Parallel::forEachThread(nthreads, comm, [&](int, Communicator *threadComm) {
+            for (size_t segIdx = nextSegment++; segIdx < numSegments; segIdx = nextSegment++) {
+                if (threadComm->IsCancelled()) {
+                    throw Communicator::CancelledException();
+                }
+                auto &connector = segmentConnectors[segIdx];
+                auto direction = getDirection(segIdx);
+                for (int end = 0; end < 2; ++end) {
+                    // leaving through the end goes along the segment, through
+                    // the start against it
+                    double outX = end == 1 ? direction.first : -direction.first;
+                    double outY = end == 1 ? direction.second : -direction.second;
+                    auto &segconns = end == 1 ? connector.forwardSegconns : connector.backSegconns;
+                    const auto &junctions =
+                        end == 1 ? segments[segIdx].endJunctions : segments[segIdx].startJunctions;
+                    for (int junction : junctions) {
+                        for (size_t i = junctionOffsets[junction]; i < junctionOffsets[junction + 1];
+                             ++i) {
+                            const auto &other = junctionEnds[i];
+                            if (other.segment == segIdx) {
+                                continue;
+                            }
+                            // entering through the start of the other segment
+                            // goes along it (1), through its end against it (-1)
+                            auto otherDirection = getDirection(other.segment);
+                            char dir = other.end == 0 ? 1 : -1;
+                            double dot = outX * otherDirection.first * dir +
+                                         outY * otherDirection.second * dir;
+                            double angle = std::acos(std::clamp(dot, -1.0, 1.0));
+                            segconns[SegmentRef(dir, static_cast<int>(other.segment))] =
+                                static_cast<float>(angle / (PI * 0.5));
+                        }
+                    }
+                }
+            }
+        });
+
+        auto segmentMap = std::make_unique<ShapeGraph>(name, ShapeMap::SEGMENTMAP);
+        segmentMap->init(numSegments, region);
+        segmentMap->initialiseAttributesSegment();
+
+        AttributeTable &table = segmentMap->getAttributeTable();
+        int axialRefCol = table.getOrInsertColumn("Axial Line Ref");
+        int lengthCol = table.getOrInsertColumn("Segment Length");
+        int angularConnectivityCol = table.getOrInsertColumn("Angular Connectivity");
+        int connectivityCol = table.getOrInsertColumn("Connectivity");
+
+        const AttributeTable &axialTable = axialMap.getAttributeTable();
+        std::vector<std::pair<size_t, int>> copiedCols;
+        if (copydata) {
+            for (size_t col = 0; col < axialTable.getNumColumns(); ++col) {
+                copiedCols.emplace_back(
+                    col, table.getOrInsertColumn("Axial " + axialTable.getColumnName(col)));
+            }
+        }
+
+        std::vector<int> segmentRefs;
+        segmentRefs.reserve(numSegments);
+        for (const auto &segment : segments) {
+            segmentRefs.push_back(segmentMap->makeLineShape(segment.line, false /* through_ui */,
+                                                            false /* tempshape */));
+        }
+
+        for (size_t segIdx = 0; segIdx < numSegments; ++segIdx) {
+            const auto &connector = segmentConnectors[segIdx];
+            float totalWeight = 0;
+            for (const auto &segconn : connector.forwardSegconns) {
+                totalWeight += segconn.second;
+            }
+            for (const auto &segconn : connector.backSegconns) {
+                totalWeight += segconn.second;
+            }
+            int axialRef = axialRefs[segmentLines[segIdx]];
+            AttributeRow &row = table.getRow(AttributeKey(segmentRefs[segIdx]));
+            row.setValue(axialRefCol, static_cast<float>(axialRef));
+            row.setValue(lengthCol, static_cast<float>(segments[segIdx].line.length()));
+            row.setValue(angularConnectivityCol, totalWeight);
+            row.setValue(connectivityCol,
+                         static_cast<float>(connector.forwardSegconns.size() +
+                                            connector.backSegconns.size()));
+            if (!copiedCols.empty()) {
+                const AttributeRow &axialRow = axialTable.getRow(AttributeKey(axialRef));
+                for (const auto &copiedCol : copiedCols) {
+                    row.setValue(copiedCol.second, axialRow.getValue(copiedCol.first));
+                }
+            }
+        }
+
+        // The lines were added in order, so the connectors (one per shape,
+        // in the order of the shapes) follow the order of the segments
+        auto &connectors = segmentMap->getConnections();
+        connectors = std::move(segmentConnectors);
+        return segmentMap;
+    }
+
+} // namespace SegmentConversion
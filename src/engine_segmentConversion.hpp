@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Multi-threaded conversion of axial maps to segment maps. The junctions are
+// taken from the connections of the axial map, so that unlinked crossings do
+// not split the lines. Each axial line is then split at its junctions and its
+// stubs removed on its own, and the segments are connected through the
+// junctions at their ends, each segment by the thread that takes it. Segments
+// and junctions are numbered in the order of the axial lines, so the result
+// does not depend on the number of threads.
+
+#pragma once
+
+#include "salalib/shapegraph.hpp"
+
+#include "communicator.hpp"
+
+#include <memory>
+#include <string>
+
+namespace SegmentConversion {
+
+    // Equivalent of sala's MapConverter::convertAxialToSegment. Stubs (the
+    // ends of axial lines past their last junction) shorter than stubRemoval
+    // times the length of their line are removed. Connections between
+    // segments are weighted by the angle of the turn, 1 for a right angle
+    std::unique_ptr<ShapeGraph> convertAxialToSegment(Communicator *comm, ShapeGraph &axialMap,
+                                                      const std::string &name, bool copydata,
+                                                      double stubRemoval, int nthreads);
+
+} // namespace SegmentConversion
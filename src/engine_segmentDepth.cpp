@@ -0,0 +1,281 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_segmentDepth.hpp"
+
+#include <Rcpp.h>
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+namespace SegmentDepth {
+
+    namespace {
+        constexpr unsigned int NOT_SEEN = std::numeric_limits<unsigned int>::max();
+        // sala's metric traversal cycles through 512 bins of distance
+        constexpr size_t METRIC_BINS = 512;
+
+        const std::string TOPOLOGICAL_COLUMN = "Topological Step Depth";
+        const std::string METRIC_COLUMN = "Metric Step Depth";
+        const std::string ANGULAR_COLUMN = "Angular Step Depth";
+
+        struct Entry {
+            uint32_t segmentIdx;
+            // the direction the segment was entered from, 0 for origins
+            int dir;
+            // the distance to the far end of the segment
+            double dist;
+        };
+
+        // Calls func(segmentIdx, dir) for the connections of the segment in
+        // the given direction (1 forward, -1 back) in the order of sala
+        template <class F>
+        void forEachConnection(const FullAngular::SegmentGraph &graph, size_t segmentIdx, int dir,
+                               F &&func) {
+            uint32_t state = static_cast<uint32_t>(segmentIdx * 2 + (dir == 1 ? 0 : 1));
+            for (size_t edge = graph.beginEdges(state); edge < graph.endEdges(state); ++edge) {
+                uint32_t targetState = graph.getTargetState(edge);
+                func(targetState / 2, targetState % 2 == 0 ? 1 : -1, graph.getWeight(edge));
+            }
+        }
+    } // namespace
+
+    SegmentAttributes::SegmentAttributes(ShapeGraph &map, const FullAngular::SegmentGraph &graph) {
+        const AttributeTable &table = map.getAttributeTable();
+        size_t axialRefColIdx = table.getColumnIndex("Axial Line Ref");
+        size_t lengthColIdx = table.getColumnIndex("Segment Length");
+        axialRefs.reserve(graph.getNumSegments());
+        lengths.reserve(graph.getNumSegments());
+        for (size_t segmentIdx = 0; segmentIdx < graph.getNumSegments(); ++segmentIdx) {
+            const auto &row = table.getRow(AttributeKey(graph.getRef(segmentIdx)));
+            axialRefs.push_back(static_cast<int>(row.getValue(axialRefColIdx)));
+            lengths.push_back(row.getValue(lengthColIdx));
+            maxLength = std::max(maxLength, lengths.back());
+        }
+    }
+
+    Searcher::Searcher(const FullAngular::SegmentGraph &graph, const SegmentAttributes &attributes)
+        : m_graph(graph), m_attributes(attributes), m_seen(graph.getNumSegments(), NOT_SEEN),
+          m_covered(graph.getNumSegments(), false) {}
+
+    std::vector<float> Searcher::getTopologicalDepths(const std::vector<size_t> &originIdxs) {
+        std::vector<float> depths(m_graph.getNumSegments(), -1.0f);
+        std::fill(m_seen.begin(), m_seen.end(), NOT_SEEN);
+
+        // segments of the same axial line are at the same depth and go to the
+        // current bin, others to the next one
+        std::vector<uint32_t> bins[2];
+        for (size_t originIdx : originIdxs) {
+            depths[originIdx] = 0.0f;
+            m_seen[originIdx] = 0;
+            bins[0].push_back(static_cast<uint32_t>(originIdx));
+        }
+
+        size_t open = originIdxs.size();
+        unsigned int segDepth = 0;
+        size_t bin = 0;
+        while (open != 0) {
+            while (bins[bin].empty()) {
+                bin = (bin + 1) % 2;
+                ++segDepth;
+            }
+            uint32_t here = bins[bin].back();
+            bins[bin].pop_back();
+            --open;
+
+            auto visit = [&](uint32_t next, int, float) {
+                if (m_seen[next] <= segDepth) {
+                    return;
+                }
+                if (m_attributes.axialRefs[next] == m_attributes.axialRefs[here]) {
+                    m_seen[next] = segDepth;
+                    bins[bin].push_back(next);
+                    depths[next] = static_cast<float>(segDepth);
+                } else {
+                    m_seen[next] = segDepth + 1;
+                    bins[(bin + 1) % 2].push_back(next);
+                    depths[next] = static_cast<float>(segDepth + 1);
+                }
+                ++open;
+            };
+            forEachConnection(m_graph, here, -1, visit);
+            forEachConnection(m_graph, here, 1, visit);
+        }
+        return depths;
+    }
+
+    std::vector<float> Searcher::getMetricDepths(const std::vector<size_t> &originIdxs) {
+        std::vector<float> depths(m_graph.getNumSegments(), -1.0f);
+        std::fill(m_seen.begin(), m_seen.end(), NOT_SEEN);
+
+        // the distance is measured from the middle of the origins
+        std::vector<std::vector<Entry>> bins(METRIC_BINS);
+        for (size_t originIdx : originIdxs) {
+            depths[originIdx] = 0.0f;
+            m_seen[originIdx] = 0;
+            bins[0].push_back(Entry{static_cast<uint32_t>(originIdx), 0,
+                                    m_attributes.lengths[originIdx] * 0.5});
+        }
+
+        size_t open = originIdxs.size();
+        unsigned int segDepth = 0;
+        size_t bin = 0;
+        while (open != 0) {
+            while (bins[bin].empty()) {
+                bin = (bin + 1) % METRIC_BINS;
+                ++segDepth;
+            }
+            Entry here = bins[bin].back();
+            bins[bin].pop_back();
+            --open;
+
+            auto visit = [&](uint32_t next, int, float) {
+                if (m_seen[next] <= segDepth) {
+                    return;
+                }
+                float length = m_attributes.lengths[next];
+                m_seen[next] = segDepth;
+                size_t binStep = m_attributes.maxLength > 0.0f
+                                     ? static_cast<size_t>(std::floor(
+                                           0.5 + 511 * length / m_attributes.maxLength))
+                                     : 0;
+                bins[(bin + binStep) % METRIC_BINS].push_back(
+                    Entry{next, here.dir, here.dist + length});
+                depths[next] = static_cast<float>(here.dist + length * 0.5);
+                ++open;
+            };
+            forEachConnection(m_graph, here.segmentIdx, -1, visit);
+            forEachConnection(m_graph, here.segmentIdx, 1, visit);
+        }
+        return depths;
+    }
+
+    std::vector<float> Searcher::getTulipDepths(const std::vector<size_t> &originIdxs,
+                                                int tulipBins) {
+        std::vector<float> depths(m_graph.getNumSegments(), -1.0f);
+        std::fill(m_covered.begin(), m_covered.end(), false);
+
+        // sala only uses a semicircle of the bins
+        const int binCount = tulipBins / 2 + 1;
+        std::vector<std::vector<Entry>> bins(binCount);
+        for (size_t originIdx : originIdxs) {
+            bins[0].push_back(Entry{static_cast<uint32_t>(originIdx), 0, 0.0});
+        }
+
+        size_t open = originIdxs.size();
+        int depthLevel = 0;
+        int bin = 0;
+        while (open != 0) {
+            while (bins[bin].empty()) {
+                bin = (bin + 1) % binCount;
+                ++depthLevel;
+            }
+            Entry here = bins[bin].back();
+            bins[bin].pop_back();
+            --open;
+            if (m_covered[here.segmentIdx]) {
+                continue;
+            }
+            m_covered[here.segmentIdx] = true;
+            depths[here.segmentIdx] = static_cast<float>(depthLevel / ((binCount - 1) * 0.5));
+
+            auto visit = [&](uint32_t next, int dir, float weight) {
+                if (m_covered[next]) {
+                    return;
+                }
+                int extraDepth = static_cast<int>(std::floor(weight * binCount * 0.5));
+                bins[(bin + binCount + extraDepth) % binCount].push_back(Entry{next, dir, 0.0});
+                ++open;
+            };
+            if (here.dir != -1) {
+                forEachConnection(m_graph, here.segmentIdx, 1, visit);
+            }
+            if (here.dir != 1) {
+                forEachConnection(m_graph, here.segmentIdx, -1, visit);
+            }
+        }
+        return depths;
+    }
+
+    const std::string &getColumnName(TraversalType traversalType) {
+        switch (traversalType) {
+        case TraversalType::Angular:
+            return ANGULAR_COLUMN;
+        case TraversalType::Topological:
+            return TOPOLOGICAL_COLUMN;
+        case TraversalType::Metric:
+            return METRIC_COLUMN;
+        case TraversalType::None:
+        default:
+            Rcpp::stop("No traversal type has been set");
+        }
+    }
+
+    std::vector<Parallel::GroupColumns>
+    runStepDepthGroups(Communicator *comm, ShapeGraph &map, TraversalType traversalType,
+                       int tulipBins, const std::vector<std::set<int>> &groupOrigins,
+                       int nthreads) {
+        const std::string &columnName = getColumnName(traversalType);
+        const bool fullAngular = traversalType == TraversalType::Angular && tulipBins == 0;
+
+        const FullAngular::SegmentGraph graph(map);
+        const SegmentAttributes attributes(map, graph);
+
+        std::vector<std::vector<size_t>> groupOriginIdxs(groupOrigins.size());
+        for (size_t groupIdx = 0; groupIdx < groupOrigins.size(); ++groupIdx) {
+            for (int origin : groupOrigins[groupIdx]) {
+                int originIdx = graph.getIndex(origin);
+                if (originIdx != -1) {
+                    groupOriginIdxs[groupIdx].push_back(static_cast<size_t>(originIdx));
+                }
+            }
+        }
+
+        const size_t numGroups = groupOrigins.size();
+        if (comm) {
+            comm->CommPostMessage(Communicator::NUM_RECORDS, numGroups);
+        }
+
+        std::vector<Parallel::GroupColumns> groupColumns(numGroups);
+        std::atomic<size_t> nextGroup(0);
+        Parallel::forEachThread(
+            Parallel::getNumThreads(nthreads, numGroups), comm,
+            [&](int, Communicator *threadComm) {
+                Searcher searcher(graph, attributes);
+                std::unique_ptr<FullAngular::Searcher> angularSearcher;
+                if (fullAngular) {
+                    angularSearcher = std::make_unique<FullAngular::Searcher>(graph);
+                }
+                for (size_t groupIdx = nextGroup++; groupIdx < numGroups;
+                     groupIdx = nextGroup++) {
+                    if (threadComm) {
+                        threadComm->CommPostMessage(Communicator::CURRENT_RECORD, groupIdx);
+                        if (threadComm->IsCancelled()) {
+                            throw Communicator::CancelledException();
+                        }
+                    }
+                    const auto &originIdxs = groupOriginIdxs[groupIdx];
+                    std::vector<float> depths;
+                    if (fullAngular) {
+                        auto angularDepths = angularSearcher->getDepths(originIdxs);
+                        depths.assign(angularDepths.begin(), angularDepths.end());
+                    } else if (traversalType == TraversalType::Angular) {
+                        depths = searcher.getTulipDepths(originIdxs, tulipBins);
+                    } else if (traversalType == TraversalType::Metric) {
+                        depths = searcher.getMetricDepths(originIdxs);
+                    } else {
+                        depths = searcher.getTopologicalDepths(originIdxs);
+                    }
+                    auto &columns = groupColumns[groupIdx];
+                    columns.completed = true;
+                    columns.names.push_back(columnName);
+                    columns.values.push_back(std::move(depths));
+                }
+            });
+        return groupColumns;
+    }
+
+} // namespace SegmentDepth
@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Step depth of segment graphs from many groups of origins at once. The
+// connections and the columns the traversals need are read from the map once
+// into a graph that all threads share, and each thread only keeps the buffers
+// of its own traversal, instead of a copy of the map. The traversals follow
+// those of sala's modules (the same bins, order of visits and values), so that
+// every group gets the same depth as when it is run through sala on its own.
+
+#pragma once
+
+#include "salalib/shapegraph.hpp"
+
+#include "communicator.hpp"
+#include "engine_segmentFullAngular.hpp"
+#include "enum_TraversalType.hpp"
+#include "helper_parallel.hpp"
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace SegmentDepth {
+
+    // The axial line and length of every segment, in the order of the
+    // segments of a FullAngular::SegmentGraph of the same map
+    struct SegmentAttributes {
+        std::vector<int> axialRefs;
+        std::vector<float> lengths;
+        float maxLength = 0.0f;
+
+        SegmentAttributes(ShapeGraph &map, const FullAngular::SegmentGraph &graph);
+    };
+
+    // Traversal buffers, one per thread, over a shared graph. All depths are
+    // given per segment, -1 for segments that can not be reached
+    class Searcher {
+        const FullAngular::SegmentGraph &m_graph;
+        const SegmentAttributes &m_attributes;
+        std::vector<unsigned int> m_seen;
+        std::vector<char> m_covered;
+
+      public:
+        Searcher(const FullAngular::SegmentGraph &graph, const SegmentAttributes &attributes);
+
+        // Steps are counted when moving to a segment of another axial line,
+        // as in sala's SegmentTopologicalPD
+        std::vector<float> getTopologicalDepths(const std::vector<size_t> &originIdxs);
+
+        // Distance between the midpoints of the segments, as in sala's
+        // SegmentMetricPD
+        std::vector<float> getMetricDepths(const std::vector<size_t> &originIdxs);
+
+        // Angular depth in the given number of tulip bins, as in sala's
+        // SegmentTulipDepth
+        std::vector<float> getTulipDepths(const std::vector<size_t> &originIdxs, int tulipBins);
+    };
+
+    // The name of the column that sala's modules write the depth to
+    const std::string &getColumnName(TraversalType traversalType);
+
+    // Runs the depth from every group of origins (shape refs), with the groups
+    // handed out to threads as they become free. Angular depth is quantised
+    // in tulipBins if given, and otherwise uses the full-precision engine
+    std::vector<Parallel::GroupColumns>
+    runStepDepthGroups(Communicator *comm, ShapeGraph &map, TraversalType traversalType,
+                       int tulipBins, const std::vector<std::set<int>> &groupOrigins,
+                       int nthreads);
+
+} // namespace SegmentDepth
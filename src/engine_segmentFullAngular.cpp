@@ -0,0 +1,246 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_segmentFullAngular.hpp"
+
+#include "helper_parallel.hpp"
+
+#include <Rcpp.h>
+
+#include <atomic>
+#include <limits>
+
+namespace FullAngular {
+
+    namespace {
+        constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+        // how many states are settled between posts to the communicator
+        constexpr size_t PROGRESS_STEP = 1024;
+
+        const std::string DEPTH_COLUMN = "Angular Step Depth";
+        const std::string PATH_COLUMN = "Angular Shortest Path Angle";
+        const std::string PATH_ORDER_COLUMN = "Angular Shortest Path Order";
+    } // namespace
+
+    SegmentGraph::SegmentGraph(ShapeGraph &map) {
+        const auto &shapes = map.getAllShapes();
+        const auto &connectors = map.getConnections();
+        if (connectors.size() != shapes.size()) {
+            Rcpp::stop("Segment graph connections (%d) do not match its shapes (%d)",
+                       connectors.size(), shapes.size());
+        }
+
+        m_refs.reserve(shapes.size());
+        for (const auto &shape : shapes) {
+            m_refs.push_back(shape.first);
+        }
+
+        m_offsets.reserve(connectors.size() * 2 + 1);
+        m_offsets.push_back(0);
+        auto addEdges = [this](const auto &segconns) {
+            for (const auto &segconn : segconns) {
+                m_targetStates.push_back(static_cast<uint32_t>(segconn.first.ref) * 2 +
+                                         (segconn.first.dir == 1 ? 0 : 1));
+                m_weights.push_back(segconn.second);
+            }
+            m_offsets.push_back(m_targetStates.size());
+        };
+        for (const auto &connector : connectors) {
+            addEdges(connector.forwardSegconns);
+            addEdges(connector.backSegconns);
+        }
+    }
+
+    int SegmentGraph::getIndex(int ref) const {
+        // refs are kept in the (sorted) order of the shapes
+        auto it = std::lower_bound(m_refs.begin(), m_refs.end(), ref);
+        if (it == m_refs.end() || *it != ref) {
+            return -1;
+        }
+        return static_cast<int>(std::distance(m_refs.begin(), it));
+    }
+
+    Searcher::Searcher(const SegmentGraph &graph)
+        : m_graph(graph), m_depth(graph.getNumSegments() * 2, -1.0),
+          m_parent(graph.getNumSegments() * 2, NO_PARENT),
+          m_settled(graph.getNumSegments() * 2, false) {}
+
+    void Searcher::reset() {
+        std::fill(m_depth.begin(), m_depth.end(), -1.0);
+        std::fill(m_parent.begin(), m_parent.end(), NO_PARENT);
+        std::fill(m_settled.begin(), m_settled.end(), false);
+        m_heap.clear();
+    }
+
+    void Searcher::addOrigin(size_t segmentIdx) {
+        for (uint32_t state = static_cast<uint32_t>(segmentIdx * 2);
+             state < static_cast<uint32_t>(segmentIdx * 2 + 2); ++state) {
+            m_depth[state] = 0.0;
+            m_heap.push(0.0, state);
+        }
+    }
+
+    int64_t Searcher::search(int64_t destinationIdx, Communicator *comm) {
+        size_t numSettled = 0;
+        while (!m_heap.empty()) {
+            auto [depth, state] = m_heap.pop();
+            if (m_settled[state]) {
+                continue;
+            }
+            m_settled[state] = true;
+            if (comm && ++numSettled % PROGRESS_STEP == 0) {
+                comm->CommPostMessage(Communicator::CURRENT_RECORD, numSettled);
+                if (comm->IsCancelled()) {
+                    throw Communicator::CancelledException();
+                }
+            }
+            if (static_cast<int64_t>(state / 2) == destinationIdx) {
+                return state;
+            }
+            for (size_t edge = m_graph.beginEdges(state); edge < m_graph.endEdges(state); ++edge) {
+                uint32_t targetState = m_graph.getTargetState(edge);
+                double targetDepth = depth + m_graph.getWeight(edge);
+                if (m_depth[targetState] < 0 || targetDepth < m_depth[targetState]) {
+                    m_depth[targetState] = targetDepth;
+                    m_parent[targetState] = state;
+                    m_heap.push(targetDepth, targetState);
+                }
+            }
+        }
+        return -1;
+    }
+
+    std::vector<double> Searcher::getDepths(const std::vector<size_t> &originIdxs,
+                                            Communicator *comm) {
+        reset();
+        for (size_t originIdx : originIdxs) {
+            addOrigin(originIdx);
+        }
+        search(-1, comm);
+
+        std::vector<double> depths(m_graph.getNumSegments(), -1.0);
+        for (size_t segmentIdx = 0; segmentIdx < depths.size(); ++segmentIdx) {
+            double forwardDepth = m_depth[segmentIdx * 2];
+            double backDepth = m_depth[segmentIdx * 2 + 1];
+            if (forwardDepth < 0 || (backDepth >= 0 && backDepth < forwardDepth)) {
+                depths[segmentIdx] = backDepth;
+            } else {
+                depths[segmentIdx] = forwardDepth;
+            }
+        }
+        return depths;
+    }
+
+    std::vector<std::pair<size_t, double>> Searcher::getShortestPath(size_t originIdx,
+                                                                     size_t destinationIdx) {
+        reset();
+        addOrigin(originIdx);
+        int64_t lastState = search(static_cast<int64_t>(destinationIdx));
+
+        std::vector<std::pair<size_t, double>> path;
+        if (lastState < 0) {
+            return path;
+        }
+        for (uint32_t state = static_cast<uint32_t>(lastState); state != NO_PARENT;
+             state = m_parent[state]) {
+            path.emplace_back(state / 2, m_depth[state]);
+        }
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    AnalysisResult runStepDepth(Communicator *comm, ShapeGraph &map,
+                                const std::set<int> &origins) {
+        SegmentGraph graph(map);
+
+        std::vector<size_t> originIdxs;
+        for (int origin : origins) {
+            int originIdx = graph.getIndex(origin);
+            if (originIdx != -1) {
+                originIdxs.push_back(static_cast<size_t>(originIdx));
+            }
+        }
+
+        if (comm) {
+            // every segment is settled once in each direction
+            comm->CommPostMessage(Communicator::NUM_RECORDS, graph.getNumSegments() * 2);
+        }
+        auto depths = Searcher(graph).getDepths(originIdxs, comm);
+
+        AttributeTable &table = map.getAttributeTable();
+        auto depthColIdx = table.getOrInsertColumn(DEPTH_COLUMN);
+        for (size_t segmentIdx = 0; segmentIdx < depths.size(); ++segmentIdx) {
+            table.getRow(AttributeKey(graph.getRef(segmentIdx)))
+                .setValue(depthColIdx, static_cast<float>(depths[segmentIdx]));
+        }
+
+        AnalysisResult result;
+        result.completed = true;
+        result.addAttribute(DEPTH_COLUMN);
+        return result;
+    }
+
+    AnalysisResult runShortestPaths(Communicator *comm, ShapeGraph &map,
+                                    const std::vector<std::pair<int, int>> &odPairs,
+                                    int nthreads) {
+        const SegmentGraph graph(map);
+
+        std::vector<std::pair<size_t, size_t>> odIdxs;
+        odIdxs.reserve(odPairs.size());
+        for (const auto &[origin, destination] : odPairs) {
+            int originIdx = graph.getIndex(origin);
+            int destinationIdx = graph.getIndex(destination);
+            if (originIdx == -1 || destinationIdx == -1) {
+                Rcpp::stop("Origin (%d) or destination (%d) not found in segment map", origin,
+                           destination);
+            }
+            odIdxs.emplace_back(originIdx, destinationIdx);
+        }
+
+        if (comm) {
+            comm->CommPostMessage(Communicator::NUM_RECORDS, odIdxs.size());
+        }
+
+        std::vector<std::vector<std::pair<size_t, double>>> paths(odIdxs.size());
+        std::atomic<size_t> nextPair(0);
+        Parallel::forEachThread(
+            Parallel::getNumThreads(nthreads, odIdxs.size()), comm,
+            [&](int, Communicator *threadComm) {
+                Searcher searcher(graph);
+                for (size_t pairIdx = nextPair++; pairIdx < odIdxs.size(); pairIdx = nextPair++) {
+                    if (threadComm) {
+                        threadComm->CommPostMessage(Communicator::CURRENT_RECORD, pairIdx);
+                        if (threadComm->IsCancelled()) {
+                            throw Communicator::CancelledException();
+                        }
+                    }
+                    paths[pairIdx] =
+                        searcher.getShortestPath(odIdxs[pairIdx].first, odIdxs[pairIdx].second);
+                }
+            });
+
+        AttributeTable &table = map.getAttributeTable();
+        auto pathColIdx = table.getOrInsertColumn(PATH_COLUMN);
+        auto orderColIdx = table.getOrInsertColumn(PATH_ORDER_COLUMN);
+        for (size_t segmentIdx = 0; segmentIdx < graph.getNumSegments(); ++segmentIdx) {
+            auto &row = table.getRow(AttributeKey(graph.getRef(segmentIdx)));
+            row.setValue(pathColIdx, -1.0f);
+            row.setValue(orderColIdx, -1.0f);
+        }
+        for (const auto &path : paths) {
+            for (size_t order = 0; order < path.size(); ++order) {
+                auto &row = table.getRow(AttributeKey(graph.getRef(path[order].first)));
+                row.setValue(pathColIdx, static_cast<float>(path[order].second));
+                row.setValue(orderColIdx, static_cast<float>(order));
+            }
+        }
+
+        AnalysisResult result;
+        result.completed = true;
+        result.addAttribute(PATH_COLUMN);
+        result.addAttribute(PATH_ORDER_COLUMN);
+        return result;
+    }
+
+} // namespace FullAngular
@@ -0,0 +1,181 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Full-precision (non-quantised) angular traversal of segment graphs. The
+// tulip modules of sala quantise the accumulated angle into bins, which is
+// fast but loses precision. This instead runs a Dijkstra search keyed on the
+// accumulated angle directly, with a radix heap as the priority queue.
+
+#pragma once
+
+#include "salalib/analysisresult.hpp"
+#include "salalib/shapegraph.hpp"
+
+#include "communicator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace FullAngular {
+
+    // Monotone priority queue for non-negative double keys. Non-negative
+    // IEEE-754 doubles keep their order when their bits are read as unsigned
+    // integers, so the keys are bucketed by the highest bit in which they
+    // differ from the last key popped. Dijkstra never pushes a key lower than
+    // the last one popped, which is all that this queue requires.
+    template <class T> class RadixHeap {
+        std::array<std::vector<std::pair<uint64_t, T>>, 65> m_buckets;
+        uint64_t m_last = 0;
+        size_t m_size = 0;
+
+        static uint64_t toBits(double key) {
+            uint64_t bits;
+            std::memcpy(&bits, &key, sizeof(bits));
+            return bits;
+        }
+
+        static double fromBits(uint64_t bits) {
+            double key;
+            std::memcpy(&key, &bits, sizeof(key));
+            return key;
+        }
+
+        static size_t bucketIdx(uint64_t bits, uint64_t last) {
+            uint64_t diff = bits ^ last;
+            if (diff == 0) {
+                return 0;
+            }
+#if defined(__GNUC__) || defined(__clang__)
+            return 64 - static_cast<size_t>(__builtin_clzll(diff));
+#else
+            size_t idx = 0;
+            while (diff != 0) {
+                diff >>= 1;
+                ++idx;
+            }
+            return idx;
+#endif
+        }
+
+      public:
+        bool empty() const { return m_size == 0; }
+
+        void clear() {
+            for (auto &bucket : m_buckets) {
+                bucket.clear();
+            }
+            m_last = 0;
+            m_size = 0;
+        }
+
+        void push(double key, T value) {
+            uint64_t bits = toBits(key < 0.0 ? 0.0 : key);
+            if (bits < m_last) {
+                // can only happen through rounding, keep the queue monotone
+                bits = m_last;
+            }
+            m_buckets[bucketIdx(bits, m_last)].emplace_back(bits, value);
+            ++m_size;
+        }
+
+        // Removes the entry with the lowest key and returns it
+        std::pair<double, T> pop() {
+            if (m_buckets[0].empty()) {
+                size_t bucket = 1;
+                while (m_buckets[bucket].empty()) {
+                    ++bucket;
+                }
+                uint64_t newLast = m_buckets[bucket].front().first;
+                for (const auto &item : m_buckets[bucket]) {
+                    newLast = std::min(newLast, item.first);
+                }
+                m_last = newLast;
+                for (const auto &item : m_buckets[bucket]) {
+                    m_buckets[bucketIdx(item.first, m_last)].push_back(item);
+                }
+                m_buckets[bucket].clear();
+            }
+            auto item = m_buckets[0].back();
+            m_buckets[0].pop_back();
+            --m_size;
+            return {fromBits(item.first), item.second};
+        }
+    };
+
+    // Flattened, read-only copy of the angular connections of a segment
+    // ShapeGraph, which may be shared between threads. Every segment has two
+    // states: one where it is left through its forward connections and one
+    // where it is left through its back connections. Arriving at a segment
+    // through a connection with direction 1 leads to the forward state and
+    // with -1 to the back state, as in the tulip analysis. Origins start from
+    // both states.
+    class SegmentGraph {
+        std::vector<int> m_refs;
+        std::vector<size_t> m_offsets;
+        std::vector<uint32_t> m_targetStates;
+        std::vector<float> m_weights;
+
+      public:
+        SegmentGraph(ShapeGraph &map);
+
+        size_t getNumSegments() const { return m_refs.size(); }
+        int getRef(size_t segmentIdx) const { return m_refs[segmentIdx]; }
+        // the index of the segment with the given shape ref or -1
+        int getIndex(int ref) const;
+
+        size_t beginEdges(uint32_t state) const { return m_offsets[state]; }
+        size_t endEdges(uint32_t state) const { return m_offsets[state + 1]; }
+        uint32_t getTargetState(size_t edge) const { return m_targetStates[edge]; }
+        float getWeight(size_t edge) const { return m_weights[edge]; }
+    };
+
+    // Search buffers, one per thread, over a shared SegmentGraph
+    class Searcher {
+        const SegmentGraph &m_graph;
+        std::vector<double> m_depth;
+        std::vector<uint32_t> m_parent;
+        std::vector<char> m_settled;
+        RadixHeap<uint32_t> m_heap;
+
+        void reset();
+        void addOrigin(size_t segmentIdx);
+        // settles states in order of depth, until the destination segment (if
+        // any) is reached. Returns the state through which it was reached.
+        // Progress (in settled states) is posted to the communicator, if any
+        int64_t search(int64_t destinationIdx, Communicator *comm = nullptr);
+
+      public:
+        Searcher(const SegmentGraph &graph);
+
+        // Angular depth of every segment from the closest of the origins,
+        // -1 for segments that can not be reached
+        std::vector<double> getDepths(const std::vector<size_t> &originIdxs,
+                                      Communicator *comm = nullptr);
+
+        // The segments along the shortest angular path from the origin to the
+        // destination along with the depth at each, empty if not reachable
+        std::vector<std::pair<size_t, double>> getShortestPath(size_t originIdx,
+                                                               size_t destinationIdx);
+    };
+
+    // Runs the depth from the given origins (shape refs) and stores it in the
+    // "Angular Step Depth" column of the map
+    AnalysisResult runStepDepth(Communicator *comm, ShapeGraph &map,
+                                const std::set<int> &origins);
+
+    // Runs the shortest paths between pairs of origin and destination (shape
+    // refs) in parallel and stores them in the same columns as sala's tulip
+    // shortest path: "Angular Shortest Path Angle" (depth along the path) and
+    // "Angular Shortest Path Order". Where paths overlap, the later pair is
+    // kept.
+    AnalysisResult runShortestPaths(Communicator *comm, ShapeGraph &map,
+                                    const std::vector<std::pair<int, int>> &odPairs,
+                                    int nthreads);
+
+} // namespace FullAngular
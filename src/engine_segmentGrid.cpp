@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_segmentGrid.hpp"
+
+#include <numeric>
+
+namespace SegmentIndex {
+
+    SegmentGrid::SegmentGrid(double minX, double minY, double maxX, double maxY, double cellSize)
+        : m_minX(minX), m_minY(minY), m_cellSize(cellSize),
+          m_cols(static_cast<size_t>((maxX - minX) / cellSize) + 1),
+          m_rows(static_cast<size_t>((maxY - minY) / cellSize) + 1),
+          m_offsets(m_cols * m_rows + 1, 0) {}
+
+    size_t SegmentGrid::getCol(double x) const {
+        return std::min(m_cols - 1, static_cast<size_t>(std::max(0.0, (x - m_minX) / m_cellSize)));
+    }
+
+    size_t SegmentGrid::getRow(double y) const {
+        return std::min(m_rows - 1, static_cast<size_t>(std::max(0.0, (y - m_minY) / m_cellSize)));
+    }
+
+    void SegmentGrid::build(const std::vector<Segment> &segments, double padding) {
+        std::vector<std::pair<size_t, uint32_t>> cellItems;
+        std::vector<size_t> cells;
+        for (size_t idx = 0; idx < segments.size(); ++idx) {
+            const auto &segment = segments[idx];
+            cells.clear();
+            forEachCell(segment[0], segment[1], segment[2], segment[3], padding,
+                        [&cells](size_t cell) { cells.push_back(cell); });
+            std::sort(cells.begin(), cells.end());
+            cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+            for (size_t cell : cells) {
+                cellItems.emplace_back(cell, static_cast<uint32_t>(idx));
+            }
+        }
+
+        // counting sort by cell
+        m_offsets.assign(m_cols * m_rows + 1, 0);
+        for (const auto &cellItem : cellItems) {
+            ++m_offsets[cellItem.first + 1];
+        }
+        std::partial_sum(m_offsets.begin(), m_offsets.end(), m_offsets.begin());
+        m_items.resize(cellItems.size());
+        std::vector<size_t> cursor(m_offsets.begin(), m_offsets.end() - 1);
+        for (const auto &cellItem : cellItems) {
+            m_items[cursor[cellItem.first]++] = cellItem.second;
+        }
+    }
+
+} // namespace SegmentIndex
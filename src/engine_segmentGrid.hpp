@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Uniform grid over a set of line segments, to find the segments near a point
+// or along another segment without testing all of them. The grid is read-only
+// once built, so that it may be shared by threads.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace SegmentIndex {
+
+    // x and y of the start and of the end of a line
+    using Segment = std::array<double, 4>;
+
+    // Uniform grid of the cells that each of a set of segments passes through
+    class SegmentGrid {
+        double m_minX = 0, m_minY = 0, m_cellSize = 1;
+        size_t m_cols = 1, m_rows = 1;
+        std::vector<size_t> m_offsets;
+        std::vector<uint32_t> m_items;
+
+        size_t getCol(double x) const;
+        size_t getRow(double y) const;
+
+      public:
+        SegmentGrid() = default;
+        SegmentGrid(double minX, double minY, double maxX, double maxY, double cellSize);
+
+        double getCellSize() const { return m_cellSize; }
+
+        // Adds the segments (by index) to all the cells they pass through,
+        // when padded by the given distance
+        void build(const std::vector<Segment> &segments, double padding);
+
+        // Calls func(item) for the items of all the cells that the segment
+        // passes through. Items may be given more than once
+        template <class F>
+        void forEachItem(double ax, double ay, double bx, double by, double padding,
+                         F &&func) const {
+            forEachCell(ax, ay, bx, by, padding, [this, &func](size_t cell) {
+                for (size_t i = m_offsets[cell]; i < m_offsets[cell + 1]; ++i) {
+                    func(m_items[i]);
+                }
+            });
+        }
+
+        // Calls func(cell) for all the cells that the segment passes through,
+        // by walking it in steps of half a cell and visiting the cells of the
+        // box around each step
+        template <class F>
+        void forEachCell(double ax, double ay, double bx, double by, double padding,
+                         F &&func) const {
+            double length = std::max(std::abs(bx - ax), std::abs(by - ay));
+            size_t steps = static_cast<size_t>(length / (m_cellSize * 0.5)) + 1;
+            for (size_t step = 0; step < steps; ++step) {
+                double tFrom = static_cast<double>(step) / steps;
+                double tTo = static_cast<double>(step + 1) / steps;
+                double xFrom = ax + tFrom * (bx - ax), xTo = ax + tTo * (bx - ax);
+                double yFrom = ay + tFrom * (by - ay), yTo = ay + tTo * (by - ay);
+                size_t colFrom = getCol(std::min(xFrom, xTo) - padding);
+                size_t colTo = getCol(std::max(xFrom, xTo) + padding);
+                size_t rowFrom = getRow(std::min(yFrom, yTo) - padding);
+                size_t rowTo = getRow(std::max(yFrom, yTo) + padding);
+                for (size_t row = rowFrom; row <= rowTo; ++row) {
+                    for (size_t col = colFrom; col <= colTo; ++col) {
+                        func(row * m_cols + col);
+                    }
+                }
+            }
+        }
+    };
+
+} // namespace SegmentIndex
@@ -0,0 +1,279 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "engine_segmentLeafChoice.hpp"
+
+#include "helper_parallel.hpp"
+
+#include <Rcpp.h>
+
+#include <cmath>
+#include <cstdint>
+
+namespace SegmentLeafChoice {
+
+    namespace {
+        constexpr int64_t NO_PREVIOUS = -1;
+
+        struct Entry {
+            uint32_t segmentIdx;
+            // the direction the segment was entered from, 0 for the origin
+            int dir;
+            // the segment it was entered from, NO_PREVIOUS for the origin
+            int64_t previous;
+            int segDepth;
+            // the distance to the far end of the segment
+            double metricDepth;
+            // the radii (as bits) within which the segment was reached
+            unsigned int coverage;
+        };
+
+        // Calls func(segmentIdx, dir, weight) for the connections of the
+        // segment in the given direction (1 forward, -1 back) in the order of
+        // sala
+        template <class F>
+        void forEachConnection(const FullAngular::SegmentGraph &graph, size_t segmentIdx, int dir,
+                               F &&func) {
+            uint32_t state = static_cast<uint32_t>(segmentIdx * 2 + (dir == 1 ? 0 : 1));
+            for (size_t edge = graph.beginEdges(state); edge < graph.endEdges(state); ++edge) {
+                uint32_t targetState = graph.getTargetState(edge);
+                func(targetState / 2, targetState % 2 == 0 ? 1 : -1, graph.getWeight(edge));
+            }
+        }
+
+        // Traversal buffers and totals of one thread
+        class Searcher {
+            const FullAngular::SegmentGraph &m_graph;
+            const std::vector<double> &m_radii;
+            const std::vector<double> &m_lengths;
+            const std::vector<double> &m_weights;
+            const RadiusType m_radiusType;
+            const int m_binCount;
+            const unsigned int m_radiusMask;
+            // the radii that each direction of each segment is still open for
+            std::vector<unsigned int> m_uncovered;
+            // per segment and radius
+            std::vector<int64_t> m_previous;
+            std::vector<char> m_leaf;
+            std::vector<std::vector<Entry>> m_bins;
+
+          public:
+            Totals totals;
+
+            Searcher(const FullAngular::SegmentGraph &graph, const std::vector<double> &radii,
+                     const std::vector<double> &lengths, const std::vector<double> &weights,
+                     RadiusType radiusType, int tulipBins)
+                : m_graph(graph), m_radii(radii), m_lengths(lengths), m_weights(weights),
+                  m_radiusType(radiusType),
+                  // sala only uses a semicircle of the bins
+                  m_binCount(tulipBins / 2 + 1),
+                  m_radiusMask((1u << radii.size()) - 1u),
+                  m_uncovered(graph.getNumSegments() * 2),
+                  m_previous(graph.getNumSegments() * radii.size()),
+                  m_leaf(graph.getNumSegments() * radii.size()), m_bins(m_binCount) {
+                const size_t numSegments = graph.getNumSegments();
+                totals.leaves.assign(radii.size(), std::vector<double>(numSegments, 0.0));
+                totals.choice.assign(radii.size(), std::vector<double>(numSegments, 0.0));
+                if (!weights.empty()) {
+                    totals.weightedChoice.assign(radii.size(),
+                                                 std::vector<double>(numSegments, 0.0));
+                }
+            }
+
+            // Whether the next segment, reached through the current one, is
+            // beyond the radius
+            bool isBeyond(size_t r, const Entry &here, int depthLevel, int extraDepth,
+                          double length) const {
+                if (m_radii[r] == -1) {
+                    return false;
+                }
+                switch (m_radiusType) {
+                case RadiusType::ANGULAR:
+                    return depthLevel + extraDepth > m_radii[r] * (m_binCount - 1) * 0.5;
+                case RadiusType::METRIC:
+                    return here.metricDepth + length * 0.5 > m_radii[r];
+                case RadiusType::TOPOLOGICAL:
+                    return here.segDepth >= static_cast<int>(m_radii[r]);
+                default:
+                    return false;
+                }
+            }
+
+            void run(size_t originIdx) {
+                const size_t numRadii = m_radii.size();
+                std::fill(m_uncovered.begin(), m_uncovered.end(), m_radiusMask);
+                std::fill(m_previous.begin(), m_previous.end(), NO_PREVIOUS);
+                std::fill(m_leaf.begin(), m_leaf.end(), true);
+                for (auto &bin : m_bins) {
+                    bin.clear();
+                }
+
+                m_bins[0].push_back(Entry{static_cast<uint32_t>(originIdx), 0, NO_PREVIOUS, 0,
+                                          m_lengths[originIdx] * 0.5, m_radiusMask});
+                size_t open = 1;
+                int depthLevel = 0;
+                int bin = 0;
+                while (open != 0) {
+                    while (m_bins[bin].empty()) {
+                        bin = (bin + 1) % m_binCount;
+                        ++depthLevel;
+                    }
+                    Entry here = m_bins[bin].back();
+                    m_bins[bin].pop_back();
+                    --open;
+
+                    const size_t segmentIdx = here.segmentIdx;
+                    unsigned int &uncovered =
+                        m_uncovered[segmentIdx * 2 + (here.dir == 1 ? 0 : 1)];
+                    const unsigned int coverage = here.coverage & uncovered;
+                    if (coverage == 0) {
+                        continue;
+                    }
+                    size_t rBase = 0;
+                    while (((coverage >> rBase) & 1u) == 0) {
+                        ++rBase;
+                    }
+                    if (here.previous != NO_PREVIOUS) {
+                        uncovered &= ~coverage;
+                        for (size_t r = rBase; r < numRadii; ++r) {
+                            // the first time a segment is reached within a
+                            // radius sets its place in the tree of that radius
+                            int64_t &previous = m_previous[segmentIdx * numRadii + r];
+                            if (((coverage >> r) & 1u) != 0 && previous == NO_PREVIOUS) {
+                                previous = here.previous;
+                                m_leaf[static_cast<size_t>(here.previous) * numRadii + r] = false;
+                            }
+                        }
+                    } else {
+                        m_uncovered[segmentIdx * 2] &= ~coverage;
+                        m_uncovered[segmentIdx * 2 + 1] &= ~coverage;
+                    }
+
+                    auto visit = [&](uint32_t next, int dir, float weight) {
+                        if ((m_uncovered[next * 2 + (dir == 1 ? 0 : 1)] & coverage) == 0) {
+                            return;
+                        }
+                        int extraDepth = static_cast<int>(std::floor(weight * m_binCount * 0.5));
+                        double length = m_lengths[next];
+                        size_t r = rBase;
+                        while (r < numRadii && isBeyond(r, here, depthLevel, extraDepth, length)) {
+                            ++r;
+                        }
+                        if (r == numRadii || (coverage >> r) == 0) {
+                            return;
+                        }
+                        m_bins[(bin + extraDepth) % m_binCount].push_back(
+                            Entry{next, dir, static_cast<int64_t>(segmentIdx), here.segDepth + 1,
+                                  here.metricDepth + length, (coverage >> r) << r});
+                        ++open;
+                    };
+                    if (here.dir != -1) {
+                        forEachConnection(m_graph, segmentIdx, 1, visit);
+                    }
+                    if (here.dir != 1) {
+                        forEachConnection(m_graph, segmentIdx, -1, visit);
+                    }
+                }
+
+                // every path from the origin to a leaf adds to the choice of
+                // the segments between them
+                const bool weighted = !m_weights.empty();
+                for (size_t segmentIdx = 0; segmentIdx < m_graph.getNumSegments(); ++segmentIdx) {
+                    for (size_t r = 0; r < numRadii; ++r) {
+                        int64_t previous = m_previous[segmentIdx * numRadii + r];
+                        if (previous == NO_PREVIOUS || !m_leaf[segmentIdx * numRadii + r]) {
+                            continue;
+                        }
+                        totals.leaves[r][segmentIdx] += 1.0;
+                        double weight =
+                            weighted ? m_weights[originIdx] * m_weights[segmentIdx] : 0.0;
+                        for (; previous != static_cast<int64_t>(originIdx);
+                             previous = m_previous[static_cast<size_t>(previous) * numRadii + r]) {
+                            totals.choice[r][previous] += 1.0;
+                            if (weighted) {
+                                totals.weightedChoice[r][previous] += weight;
+                            }
+                        }
+                    }
+                }
+            }
+        };
+    } // namespace
+
+    std::vector<double> getRadii(const std::set<double> &radiusSet) {
+        std::vector<double> radii;
+        bool radiusN = false;
+        for (double radius : radiusSet) {
+            if (radius == -1) {
+                radiusN = true;
+            } else {
+                radii.push_back(radius);
+            }
+        }
+        if (radiusN) {
+            radii.push_back(-1);
+        }
+        return radii;
+    }
+
+    Totals run(Communicator *comm, ShapeGraph &map, const FullAngular::SegmentGraph &graph,
+               const std::vector<double> &radii, int tulipBins, int weightedMeasureColIdx,
+               RadiusType radiusType, int nthreads) {
+        const size_t numSegments = graph.getNumSegments();
+        if (radii.empty() || radii.size() >= sizeof(unsigned int) * 8) {
+            Rcpp::stop("Leaf choice needs between 1 and %d radii (%d provided)",
+                       sizeof(unsigned int) * 8 - 1, radii.size());
+        }
+
+        const AttributeTable &table = map.getAttributeTable();
+        size_t lengthColIdx = table.getColumnIndex("Segment Length");
+        std::vector<double> lengths, weights;
+        lengths.reserve(numSegments);
+        if (weightedMeasureColIdx != -1) {
+            weights.reserve(numSegments);
+        }
+        for (size_t segmentIdx = 0; segmentIdx < numSegments; ++segmentIdx) {
+            const auto &row = table.getRow(AttributeKey(graph.getRef(segmentIdx)));
+            lengths.push_back(row.getValue(lengthColIdx));
+            if (weightedMeasureColIdx != -1) {
+                weights.push_back(row.getValue(weightedMeasureColIdx));
+            }
+        }
+
+        if (comm) {
+            comm->CommPostMessage(Communicator::NUM_RECORDS, numSegments);
+        }
+
+        nthreads = Parallel::getNumThreads(nthreads, numSegments);
+        std::vector<Totals> threadTotals(nthreads);
+        Parallel::forEachThread(nthreads, comm, [&](int threadIdx, Communicator *threadComm) {
+            Searcher searcher(graph, radii, lengths, weights, radiusType, tulipBins);
+            for (size_t originIdx = threadIdx; originIdx < numSegments; originIdx += nthreads) {
+                threadComm->CommPostMessage(Communicator::CURRENT_RECORD, originIdx);
+                if (threadComm->IsCancelled()) {
+                    throw Communicator::CancelledException();
+                }
+                searcher.run(originIdx);
+            }
+            threadTotals[threadIdx] = std::move(searcher.totals);
+        });
+
+        Totals totals = std::move(threadTotals[0]);
+        auto addUp = [](std::vector<std::vector<double>> &target,
+                        const std::vector<std::vector<double>> &part) {
+            for (size_t r = 0; r < target.size(); ++r) {
+                for (size_t segmentIdx = 0; segmentIdx < target[r].size(); ++segmentIdx) {
+                    target[r][segmentIdx] += part[r][segmentIdx];
+                }
+            }
+        };
+        for (int threadIdx = 1; threadIdx < nthreads; ++threadIdx) {
+            addUp(totals.leaves, threadTotals[threadIdx].leaves);
+            addUp(totals.choice, threadTotals[threadIdx].choice);
+            addUp(totals.weightedChoice, threadTotals[threadIdx].weightedChoice);
+        }
+        return totals;
+    }
+
+} // namespace SegmentLeafChoice
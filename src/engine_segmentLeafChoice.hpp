@@ -0,0 +1,47 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Tulip leaf choice of segment graphs with the origins split between threads.
+// The connections, lengths and weights are read from the map once and shared
+// by all threads, and each thread only keeps the buffers of its own traversal
+// and its own leaf and choice totals. The traversal follows that of sala's
+// SegmentTulipLeafChoice (the same bins, radius coverage and order of visits),
+// and the totals of the threads are added up once at the end.
+
+#pragma once
+
+#include "salalib/radiustype.hpp"
+#include "salalib/shapegraph.hpp"
+
+#include "communicator.hpp"
+#include "engine_segmentFullAngular.hpp"
+
+#include <set>
+#include <vector>
+
+namespace SegmentLeafChoice {
+
+    // Totals per radius and segment, with the segments in the order of the
+    // given FullAngular::SegmentGraph
+    struct Totals {
+        // the number of origins from which the segment was a leaf
+        std::vector<std::vector<double>> leaves;
+        // the number of paths from an origin to a leaf through the segment,
+        // and the same weighted by the weights of the origin and the leaf
+        std::vector<std::vector<double>> choice, weightedChoice;
+    };
+
+    // The radii in the order that sala's tulip analysis goes through them:
+    // ascending, with radius n (-1) last
+    std::vector<double> getRadii(const std::set<double> &radiusSet);
+
+    // Runs the traversal from every segment, with the origins interleaved
+    // between threads so that every thread gets a similar mix of central and
+    // peripheral segments. The totals are added up in thread order, so that
+    // the result does not depend on the scheduling
+    Totals run(Communicator *comm, ShapeGraph &map, const FullAngular::SegmentGraph &graph,
+               const std::vector<double> &radii, int tulipBins, int weightedMeasureColIdx,
+               RadiusType radiusType, int nthreads);
+
+} // namespace SegmentLeafChoice
@@ -0,0 +1,18 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+// The values here should be kept the same as the ones in isovist.R
+
+#pragma once
+
+#include <Rcpp.h>
+
+enum class IsovistAlgorithm {
+    None = 0,
+    BSPTree = 1,
+    RayCasting = 2,
+    // remember to change maximum if adding values here
+    min = None,
+    max = RayCasting
+};
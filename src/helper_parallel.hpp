@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#pragma once
+
+#include "salalib/analysisresult.hpp"
+#include "salalib/attributetable.hpp"
+#include "salalib/shapegraph.hpp"
+
+#include "communicator.hpp"
+
+#include <Rcpp.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Parallel {
+
+    // Validates the number of threads given from R and resolves 0 to "all
+    // available". The result is also capped to the number of work items, as
+    // there is no point in starting threads that will have nothing to do
+    inline int getNumThreads(int nthreads, size_t numItems = 0) {
+        if (nthreads < 0) {
+            Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" +
+                       std::to_string(nthreads) + " provided)");
+        }
+        if (nthreads == 0) {
+#ifdef _OPENMP
+            nthreads = omp_get_max_threads();
+#else
+            nthreads = 1;
+#endif
+        }
+        if (numItems > 0 && static_cast<size_t>(nthreads) > numItems) {
+            nthreads = static_cast<int>(numItems);
+        }
+        return std::max(nthreads, 1);
+    }
+
+    // Runs func(threadIdx, comm) once for every thread index in [0, nthreads).
+    // Index 0 always runs on the calling (R main) thread and is the only one
+    // given a communicator that forwards to mainComm (if any). Exceptions do
+    // not leave the parallel region; the first one that is not a cancellation
+    // (or the cancellation itself) is rethrown once all threads have finished
+    template <class F> void forEachThread(int nthreads, Communicator *mainComm, F &&func) {
+        std::atomic<bool> cancelFlag(false);
+        std::vector<std::exception_ptr> errors(nthreads);
+        // char instead of bool so that threads write to separate bytes
+        std::vector<char> cancelled(nthreads, false);
+
+#pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+        for (int threadIdx = 0; threadIdx < nthreads; ++threadIdx) {
+            ThreadCommunicator threadComm(threadIdx == 0 ? mainComm : nullptr, cancelFlag);
+            try {
+                func(threadIdx, &threadComm);
+            } catch (Communicator::CancelledException &) {
+                cancelled[threadIdx] = true;
+                cancelFlag = true;
+            } catch (...) {
+                errors[threadIdx] = std::current_exception();
+                cancelFlag = true;
+            }
+        }
+
+        for (auto &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        if (std::find(cancelled.begin(), cancelled.end(), char(true)) != cancelled.end()) {
+            throw Communicator::CancelledException();
+        }
+    }
+
+    // Adds the values of the given columns of a partial result table to the
+    // same columns of the target table, for analyses that accumulate values
+    // (e.g. choice) and have been split by origin. Both tables are expected to
+    // contain the same rows. -1 is the "no value" marker used throughout sala
+    // so it is not added
+    inline void addColumns(AttributeTable &target, const AttributeTable &part,
+                           const std::vector<std::string> &columns) {
+        for (const auto &column : columns) {
+            size_t targetColIdx = target.getColumnIndex(column);
+            size_t partColIdx = part.getColumnIndex(column);
+            for (auto partIt = part.begin(); partIt != part.end(); ++partIt) {
+                float partValue = partIt->getRow().getValue(partColIdx);
+                if (partValue == -1.0f) {
+                    continue;
+                }
+                auto &row = target.getRow(partIt->getKey());
+                float value = row.getValue(targetColIdx);
+                row.setValue(targetColIdx, value == -1.0f ? partValue : value + partValue);
+            }
+        }
+    }
+
+    // The columns an analysis created for one group of origins, along with
+    // their values in the row order of the map
+    struct GroupColumns {
+        bool completed = false;
+        std::vector<std::string> names;
+        std::vector<std::vector<float>> values;
+    };
+
+    // Writes the collected group columns to the map they were computed from
+    // (in group order) as "<column> [<group name>]", and returns the names of
+    // the new columns
+    inline std::vector<std::string> writeGroupColumns(AttributeTable &table,
+                                                      const std::vector<GroupColumns> &groupColumns,
+                                                      const std::vector<std::string> &groupNames) {
+        std::vector<std::string> newColumns;
+        for (size_t groupIdx = 0; groupIdx < groupColumns.size(); ++groupIdx) {
+            const auto &columns = groupColumns[groupIdx];
+            for (size_t i = 0; i < columns.names.size(); ++i) {
+                std::string colName = columns.names[i] + " [" + groupNames[groupIdx] + "]";
+                size_t colIdx = table.getOrInsertColumn(colName);
+                auto valueIt = columns.values[i].begin();
+                for (auto rowIt = table.begin(); rowIt != table.end(); ++rowIt, ++valueIt) {
+                    rowIt->getRow().setValue(colIdx, *valueIt);
+                }
+                newColumns.push_back(colName);
+            }
+        }
+        return newColumns;
+    }
+
+} // namespace Parallel
@@ -16,6 +16,160 @@ namespace { // anonymous
         return "df_" + std::to_string(rColIdx) + "_" + colName;
     }
 
+    // A numeric column of the dataframe and the ShapeMap column it goes to
+    struct AttributeSource {
+        int colIdx;
+        // keeps the R vector protected while its memory is read
+        Rcpp::RObject vector;
+        const int *intValues = nullptr;
+        const double *realValues = nullptr;
+
+        AttributeSource(int colIdx, SEXP rVector) : colIdx(colIdx), vector(rVector) {
+            if (TYPEOF(rVector) == INTSXP) {
+                intValues = INTEGER(rVector);
+            } else {
+                realValues = REAL(rVector);
+            }
+        }
+
+        float get(R_xlen_t row) const {
+            return intValues ? float(intValues[row]) : float(realValues[row]);
+        }
+    };
+
+    // The type of an sf geometry (sfg) from its class, e.g. c("XY",
+    // "LINESTRING", "sfg"), or an empty string if it has none
+    std::string getGeometryType(SEXP sfg) {
+        SEXP cls = Rf_getAttrib(sfg, R_ClassSymbol);
+        if (TYPEOF(cls) != STRSXP || Rf_xlength(cls) < 2) {
+            return "";
+        }
+        return CHAR(STRING_ELT(cls, 1));
+    }
+
+    enum class PartKind { Points, LineString, Ring, Unknown };
+
+    // Hands a coordinate matrix of an sf geometry (column-major, with x in
+    // the first column and y in the second) or a single point vector to
+    // the sink, straight from the memory of the R vector
+    template <class Sink> void decodeCoordinates(SEXP coords, PartKind kind, Sink &sink) {
+        if (TYPEOF(coords) != REALSXP) {
+            Rcpp::stop("Unsupported geometry coordinates");
+        }
+        const double *xy = REAL(coords);
+        if (!Rf_isMatrix(coords)) {
+            // empty points are NA
+            if (Rf_xlength(coords) >= 2 && !ISNAN(xy[0]) && !ISNAN(xy[1])) {
+                sink.point(xy[0], xy[1]);
+            }
+            return;
+        }
+        const int numRows = Rf_nrows(coords);
+        if (kind == PartKind::Unknown) {
+            // without a geometry type, the shape is picked by the number
+            // of points
+            kind = numRows == 1 ? PartKind::Points
+                                : (numRows == 2 ? PartKind::LineString : PartKind::Ring);
+        }
+        switch (kind) {
+        case PartKind::Points:
+            for (int rowIdx = 0; rowIdx < numRows; ++rowIdx) {
+                sink.point(xy[rowIdx], xy[rowIdx + numRows]);
+            }
+            break;
+        case PartKind::LineString:
+            sink.lineString(xy, numRows);
+            break;
+        case PartKind::Ring:
+            sink.ring(xy, numRows);
+            break;
+        case PartKind::Unknown:
+            break;
+        }
+    }
+
+    template <class Sink> void decodeCoordinateList(SEXP list, PartKind kind, Sink &sink) {
+        for (R_xlen_t i = 0; i < Rf_xlength(list); ++i) {
+            decodeCoordinates(VECTOR_ELT(list, i), kind, sink);
+        }
+    }
+
+    // Walks all the parts of an sf geometry in one pass: every part of
+    // multi-geometries, the holes of polygons as well as their outer rings,
+    // and the members of geometry collections
+    template <class Sink> void decodeGeometry(SEXP sfg, Sink &sink) {
+        const std::string type = getGeometryType(sfg);
+        if (type == "POINT" || type == "MULTIPOINT") {
+            decodeCoordinates(sfg, PartKind::Points, sink);
+        } else if (type == "LINESTRING") {
+            decodeCoordinates(sfg, PartKind::LineString, sink);
+        } else if (type == "MULTILINESTRING") {
+            decodeCoordinateList(sfg, PartKind::LineString, sink);
+        } else if (type == "POLYGON") {
+            decodeCoordinateList(sfg, PartKind::Ring, sink);
+        } else if (type == "MULTIPOLYGON") {
+            for (R_xlen_t i = 0; i < Rf_xlength(sfg); ++i) {
+                decodeCoordinateList(VECTOR_ELT(sfg, i), PartKind::Ring, sink);
+            }
+        } else if (TYPEOF(sfg) == VECSXP) {
+            // geometry collections and lists without a known type
+            for (R_xlen_t i = 0; i < Rf_xlength(sfg); ++i) {
+                decodeGeometry(VECTOR_ELT(sfg, i), sink);
+            }
+        } else {
+            decodeCoordinates(sfg, PartKind::Unknown, sink);
+        }
+    }
+
+    // Makes a shape out of every part of the geometries, noting the
+    // dataframe row it came from
+    struct ShapeMapSink {
+        ShapeMap &shapeMap;
+        R_xlen_t dfRow = 0;
+        std::vector<int> shapeRefs;
+        std::vector<R_xlen_t> dfRows;
+        std::vector<Point2f> points;
+
+        ShapeMapSink(ShapeMap &shapeMap) : shapeMap(shapeMap) {}
+
+        void addShape(int shapeRef) {
+            if (shapeRef != -1) {
+                shapeRefs.push_back(shapeRef);
+                dfRows.push_back(dfRow);
+            }
+        }
+
+        void setPoints(const double *xy, int numRows) {
+            points.clear();
+            points.reserve(numRows);
+            for (int rowIdx = 0; rowIdx < numRows; ++rowIdx) {
+                points.emplace_back(xy[rowIdx], xy[rowIdx + numRows]);
+            }
+        }
+
+        void point(double x, double y) {
+            addShape(shapeMap.makePointShape(Point2f(x, y), false /* tempshape */));
+        }
+
+        void lineString(const double *xy, int numRows) {
+            if (numRows == 2) {
+                Line4f line(Point2f(xy[0], xy[2]), Point2f(xy[1], xy[3]));
+                addShape(
+                    shapeMap.makeLineShape(line, false /* through_ui */, false /* tempshape */));
+            } else if (numRows > 2) {
+                setPoints(xy, numRows);
+                addShape(shapeMap.makePolyShape(points, true /* open */, false /* tempshape */));
+            }
+        }
+
+        void ring(const double *xy, int numRows) {
+            if (numRows > 2) {
+                setPoints(xy, numRows);
+                addShape(shapeMap.makePolyShape(points, false /* open */, false /* tempshape */));
+            }
+        }
+    };
+
 } // namespace
 
 // [[Rcpp::export("Rcpp_getSfShapeMapExpectedColName")]]
@@ -53,13 +207,9 @@ toShapeMap(Rcpp::DataFrame &df,
 
     Rcpp::XPtr<ShapeMap> shp(new ShapeMap("tmp_df_shp"));
 
-    // Rcpp vectors are pointers to the actual vectors, so we store
-    // them here along with the column index and the iterator (useful
-    // later for going through the vector)
-    std::vector<std::tuple<const int, Rcpp::IntegerVector, Rcpp::IntegerVector::const_iterator>>
-        iIts;
-    std::vector<std::tuple<const int, Rcpp::NumericVector, Rcpp::NumericVector::const_iterator>>
-        rIts;
+    // The numeric columns are read straight from the memory of the R
+    // vectors, which are kept here so that they stay protected
+    std::vector<AttributeSource> attributeSources;
 
     { // create the row-names column in the ShapeMap
         const int rowNameColIdx = shp->addAttribute("df_row_name");
@@ -67,21 +217,7 @@ toShapeMap(Rcpp::DataFrame &df,
             // error adding column (e.g., duplicate column names)
             Rcpp::stop("Error creating df row column");
         }
-
-        switch (TYPEOF(dfrn)) {
-        case INTSXP: {
-            auto &newItem = iIts.emplace_back(rowNameColIdx,
-                                              Rcpp::as<const Rcpp::IntegerVector>(dfrn), nullptr);
-            std::get<2>(newItem) = std::get<1>(newItem).begin();
-            break;
-        }
-        case REALSXP: {
-            auto &newItem = rIts.emplace_back(rowNameColIdx,
-                                              Rcpp::as<const Rcpp::NumericVector>(dfrn), nullptr);
-            std::get<2>(newItem) = std::get<1>(newItem).begin();
-            break;
-        }
-        }
+        attributeSources.emplace_back(rowNameColIdx, dfrn);
     }
 
     // for any other columns it has been requested, create in ShapeMap
@@ -100,9 +236,7 @@ toShapeMap(Rcpp::DataFrame &df,
                 // error adding column (e.g., duplicate column names)
                 Rcpp::stop("Error creating df column (%d: %s)", colIdx, colName);
             }
-            auto &newItem =
-                iIts.emplace_back(newColIdx, Rcpp::as<const Rcpp::IntegerVector>(col), nullptr);
-            std::get<2>(newItem) = std::get<1>(newItem).begin();
+            attributeSources.emplace_back(newColIdx, col);
             break;
         }
         case REALSXP: {
@@ -112,9 +246,7 @@ toShapeMap(Rcpp::DataFrame &df,
                 // error adding column (e.g., duplicate column names)
                 Rcpp::stop("Error creating df column (%d: %s)", colIdx, colName);
             }
-            auto &newItem =
-                rIts.emplace_back(newColIdx, Rcpp::as<const Rcpp::NumericVector>(col), nullptr);
-            std::get<2>(newItem) = std::get<1>(newItem).begin();
+            attributeSources.emplace_back(newColIdx, col);
             break;
         }
         case STRSXP: {
@@ -133,54 +265,29 @@ toShapeMap(Rcpp::DataFrame &df,
         }
     }
 
-    for (auto git = geom.begin(); git != geom.end(); ++git) {
-        Rcpp::NumericMatrix coords;
-        if (TYPEOF(*git) == VECSXP) {
-            // multi-object item
-            auto multiObject = Rcpp::as<Rcpp::GenericVector>(*git);
-            // for the moment only get the first
-            coords = Rcpp::as<Rcpp::NumericMatrix>(multiObject[0]);
-        } else {
-            coords = Rcpp::as<Rcpp::NumericMatrix>(*git);
-        }
-
-        // TODO: Make this a vector of pairs
-        std::map<size_t, float> extraAttributes;
-
-        for (auto &idxiit : iIts) {
-            extraAttributes.emplace(std::get<0>(idxiit), *std::get<2>(idxiit));
-        }
-        for (auto &idxrit : rIts) {
-            extraAttributes.emplace(std::get<0>(idxrit), *std::get<2>(idxrit));
-        }
-
-        if (coords.rows() == 1) {
-            // 2D point x1,y1
-            Point2f point(coords[0], coords[1]);
-            shp->makePointShape(point, false /* tempshape */, extraAttributes);
-        } else if (coords.rows() == 2) {
-            // 2D line x1,x2,y1,y2
-
-            Line4f line(Point2f(coords[0], coords[2]), Point2f(coords[1], coords[3]));
-            shp->makeLineShape(line, false /* through_ui */, false /* tempshape */,
-                               extraAttributes);
-        } else if (coords.rows() > 2) {
-            // 2D polygon x1,x2,y1,y2
-            // TODO: Make this a vector of pairs
-
-            std::vector<Point2f> points;
-            for (int rowIdx = 0; rowIdx < coords.rows(); ++rowIdx) {
-                const Rcpp::NumericMatrix::Row &row = coords(rowIdx, Rcpp::_);
-                points.push_back(Point2f(row[0], row[1]));
-            }
+    // The shapes are made first and the attributes are then written a column
+    // at a time, rather than handing a map of values to every shape. Every
+    // part of a geometry becomes a shape with the attributes of its row
+    ShapeMapSink sink(*shp);
+    const R_xlen_t numGeometries = geom.size();
+    sink.shapeRefs.reserve(numGeometries);
+    sink.dfRows.reserve(numGeometries);
+    for (R_xlen_t dfRow = 0; dfRow < numGeometries; ++dfRow) {
+        sink.dfRow = dfRow;
+        decodeGeometry(VECTOR_ELT(geom, dfRow), sink);
+    }
+    const auto &shapeRefs = sink.shapeRefs;
+    const auto &dfRows = sink.dfRows;
 
-            shp->makePolyShape(points, false /* open */, false /* tempshape */, extraAttributes);
-        }
-        for (auto &idxiit : iIts) {
-            ++std::get<2>(idxiit);
-        }
-        for (auto &idxrit : rIts) {
-            ++std::get<2>(idxrit);
+    AttributeTable &table = shp->getAttributeTable();
+    std::vector<AttributeRow *> rows;
+    rows.reserve(shapeRefs.size());
+    for (int shapeRef : shapeRefs) {
+        rows.push_back(&table.getRow(AttributeKey(shapeRef)));
+    }
+    for (const auto &source : attributeSources) {
+        for (size_t i = 0; i < rows.size(); ++i) {
+            rows[i]->setValue(source.colIdx, source.get(dfRows[i]));
         }
     }
     return shp;
@@ -8,24 +8,40 @@
 #include "salalib/shapegraph.hpp"
 #include "salalib/shapemap.hpp"
 
+#include "engine_axialConversion.hpp"
+#include "engine_segmentConversion.hpp"
 #include "helper_nullablevalue.hpp"
 
 #include "communicator.hpp"
 
 #include <Rcpp.h>
 
+// [[Rcpp::plugins(openmp)]]
+
 // [[Rcpp::export("Rcpp_toAxialShapeGraph")]]
 Rcpp::List toAxialShapeGraph(Rcpp::XPtr<ShapeMap> shapeMap,
                              const Rcpp::Nullable<std::string> nameNV = R_NilValue,
                              const Rcpp::Nullable<bool> copydataNV = R_NilValue,
-                             const Rcpp::Nullable<bool> progressNV = R_NilValue) {
+                             const Rcpp::Nullable<bool> progressNV = R_NilValue,
+                             const Rcpp::Nullable<int> nthreadsNV = R_NilValue) {
 
     auto name = NullableValue::get(nameNV, std::string("ax_map"));
     auto copydata = NullableValue::get(copydataNV, true);
     auto progress = NullableValue::get(progressNV, false);
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
 
-    std::unique_ptr<ShapeGraph> axMap(MapConverter::convertDataToAxial(
-        getCommunicator(progress).get(), name, *(shapeMap.get()), copydata));
+    std::unique_ptr<ShapeGraph> axMap;
+    if (nthreads == 1) {
+        axMap = MapConverter::convertDataToAxial(getCommunicator(progress).get(), name,
+                                                 *(shapeMap.get()), copydata);
+    } else {
+        axMap = AxialConversion::convertDataToAxial(getCommunicator(progress).get(), name,
+                                                    *(shapeMap.get()), copydata, nthreads);
+    }
 
     auto shapeMapNames = getShapeMapAttributeNames(shapeMap.get());
     auto newNames = getShapeMapAttributeNames(axMap.get());
@@ -50,19 +66,32 @@ Rcpp::XPtr<ShapeGraph> axialToSegment(Rcpp::XPtr<ShapeGraph> shapeGraph,
                                       const Rcpp::Nullable<std::string> nameNV = R_NilValue,
                                       const Rcpp::Nullable<bool> copydataNV = R_NilValue,
                                       const Rcpp::Nullable<double> stubremovalNV = R_NilValue,
-                                      const Rcpp::Nullable<bool> progressNV = R_NilValue) {
+                                      const Rcpp::Nullable<bool> progressNV = R_NilValue,
+                                      const Rcpp::Nullable<int> nthreadsNV = R_NilValue) {
 
     auto name = NullableValue::get(nameNV, std::string("seg_map"));
     auto copydata = NullableValue::get(copydataNV, true);
     auto stubremoval = NullableValue::get(stubremovalNV, 0.0);
     auto progress = NullableValue::get(progressNV, false);
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
 
-    // keepOriginal - will try to remove it from shapeGraphs, but since
-    // this is a plain conversion it's not necessary
-    std::unique_ptr<ShapeGraph> segMap(MapConverter::convertAxialToSegment(
-        getCommunicator(progress).get(), *(shapeGraph.get()), name,
-        true, // keepOriginal
-        copydata, stubremoval));
+    std::unique_ptr<ShapeGraph> segMap;
+    if (nthreads == 1) {
+        // keepOriginal - will try to remove it from shapeGraphs, but since
+        // this is a plain conversion it's not necessary
+        segMap = MapConverter::convertAxialToSegment(getCommunicator(progress).get(),
+                                                     *(shapeGraph.get()), name,
+                                                     true, // keepOriginal
+                                                     copydata, stubremoval);
+    } else {
+        segMap = SegmentConversion::convertAxialToSegment(getCommunicator(progress).get(),
+                                                          *(shapeGraph.get()), name, copydata,
+                                                          stubremoval, nthreads);
+    }
 
     return Rcpp::XPtr<ShapeGraph>(segMap.release());
 }
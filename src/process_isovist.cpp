@@ -2,17 +2,26 @@
 //
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include "process_isovist.hpp"
+
 #include "salalib/isovist.hpp"
 #include "salalib/shapemap.hpp"
 
+#include "engine_isovistRays.hpp"
+#include "enum_IsovistAlgorithm.hpp"
 #include "helper_nullablevalue.hpp"
+#include "helper_parallel.hpp"
 
 #include "communicator.hpp"
 
 #include <Rcpp.h>
+
+#include <atomic>
 #include <memory>
 
-bool makeBSPtree(Communicator *communicator, BSPNode *bspRoot, ShapeMap &boundsMap) {
+// [[Rcpp::plugins(openmp)]]
+
+std::vector<Line4f> getBoundaryLines(ShapeMap &boundsMap) {
 
     std::vector<Line4f> partitionlines;
 
@@ -28,6 +37,11 @@ bool makeBSPtree(Communicator *communicator, BSPNode *bspRoot, ShapeMap &boundsM
             }
         }
     }
+    return partitionlines;
+}
+
+bool makeBSPtree(Communicator *communicator, BSPNode *bspRoot,
+                 const std::vector<Line4f> &partitionlines) {
 
     if (partitionlines.size()) {
 
@@ -49,63 +63,81 @@ bool makeBSPtree(Communicator *communicator, BSPNode *bspRoot, ShapeMap &boundsM
     return false;
 }
 
-std::set<std::string> setIsovistData(Isovist &isovist, AttributeTable &table, AttributeRow &row,
-                                     bool simple_version) {
-    std::set<std::string> newAttributes;
+// The polygon of an isovist, kept apart from the map so that isovists can be
+// made in parallel and added to the map afterwards
+struct IsovistShape {
+    Point2f origin;
+    std::vector<Point2f> polygon;
+};
+
+const std::vector<std::string> &getIsovistColumns(bool simple_version) {
+    static const std::vector<std::string> simpleColumns = {"Isovist Area"};
+    static const std::vector<std::string> columns = {
+        "Isovist Area",            //
+        "Isovist Compactness",     //
+        "Isovist Drift Angle",     //
+        "Isovist Drift Magnitude", //
+        "Isovist Min Radial",      //
+        "Isovist Max Radial",      //
+        "Isovist Occlusivity",     //
+        "Isovist Perimeter"};
+    return simple_version ? simpleColumns : columns;
+}
+
+// Stores the measures of the isovist at the given index of each of the
+// column arrays, which are in the order given by getIsovistColumns
+void setIsovistData(Isovist &isovist, std::vector<std::vector<float>> &columnValues,
+                    size_t idx, bool simple_version) {
     auto [centroid, area] = isovist.getCentroidArea();
+    columnValues[0][idx] = float(area);
+    if (simple_version) {
+        return;
+    }
     auto [driftmag, driftang] = isovist.getDriftData();
     double perimeter = isovist.getPerimeter();
+    columnValues[1][idx] = float(4.0 * M_PI * area / (perimeter * perimeter));
+    columnValues[2][idx] = float(180.0 * driftang / M_PI);
+    columnValues[3][idx] = float(driftmag);
+    columnValues[4][idx] = float(isovist.getMinRadial());
+    columnValues[5][idx] = float(isovist.getMaxRadial());
+    columnValues[6][idx] = float(isovist.getOccludedPerimeter());
+    columnValues[7][idx] = float(perimeter);
+}
 
-    std::string colText = "Isovist Area";
-    int col = table.getOrInsertColumn(colText);
-    newAttributes.insert(colText);
-    row.setValue(col, float(area));
-
-    if (!simple_version) {
-        colText = "Isovist Compactness";
-        col = table.getOrInsertColumn(colText);
-        newAttributes.insert(colText);
-        row.setValue(col, float(4.0 * M_PI * area / (perimeter * perimeter)));
-
-        colText = "Isovist Drift Angle";
-        col = table.getOrInsertColumn(colText);
-        newAttributes.insert(colText);
-        row.setValue(col, float(180.0 * driftang / M_PI));
-
-        colText = "Isovist Drift Magnitude";
-        col = table.getOrInsertColumn(colText);
-        newAttributes.insert(colText);
-        row.setValue(col, float(driftmag));
-
-        colText = "Isovist Min Radial";
-        col = table.getOrInsertColumn(colText);
-        newAttributes.insert(colText);
-        row.setValue(col, float(isovist.getMinRadial()));
-
-        colText = "Isovist Max Radial";
-        col = table.getOrInsertColumn(colText);
-        newAttributes.insert(colText);
-        row.setValue(col, float(isovist.getMaxRadial()));
-
-        colText = "Isovist Occlusivity";
-        col = table.getOrInsertColumn(colText);
-        newAttributes.insert(colText);
-        row.setValue(col, float(isovist.getOccludedPerimeter()));
-
-        colText = "Isovist Perimeter";
-        col = table.getOrInsertColumn(colText);
-        newAttributes.insert(colText);
-        row.setValue(col, float(perimeter));
-    }
-    return newAttributes;
+// As setIsovistData, for an isovist made by casting rays
+void setIsovistData(const IsovistRays::Isovist &isovist,
+                    std::vector<std::vector<float>> &columnValues, size_t idx,
+                    bool simple_version) {
+    columnValues[0][idx] = float(isovist.area);
+    if (simple_version) {
+        return;
+    }
+    double perimeter = isovist.perimeter;
+    columnValues[1][idx] = float(4.0 * M_PI * isovist.area / (perimeter * perimeter));
+    columnValues[2][idx] = float(180.0 * isovist.driftAngle / M_PI);
+    columnValues[3][idx] = float(isovist.driftMagnitude);
+    columnValues[4][idx] = float(isovist.minRadial);
+    columnValues[5][idx] = float(isovist.maxRadial);
+    columnValues[6][idx] = float(isovist.occlusivity);
+    columnValues[7][idx] = float(perimeter);
 }
 
-// [[Rcpp::export("Rcpp_makeIsovists")]]
-Rcpp::XPtr<ShapeMap> makeIsovists(Rcpp::XPtr<ShapeMap> boundsMap, Rcpp::NumericMatrix pointCoords,
-                                  Rcpp::NumericVector directionAngles,
-                                  Rcpp::NumericVector fieldOfViewAngles,
-                                  const Rcpp::Nullable<bool> progressNV = R_NilValue) {
-    auto progress = NullableValue::get(progressNV, false);
+// Checks the inputs of the isovists and expands the angles given once to all
+// the points
+void prepareIsovistInputs(const Rcpp::NumericMatrix &pointCoords,
+                          Rcpp::NumericVector &directionAngles,
+                          Rcpp::NumericVector &fieldOfViewAngles, int nthreads,
+                          IsovistAlgorithm algorithm, int numRays) {
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
+    if (algorithm != IsovistAlgorithm::BSPTree && algorithm != IsovistAlgorithm::RayCasting) {
+        Rcpp::stop("Unknown algorithm provided: " + std::to_string(static_cast<int>(algorithm)));
+    }
+    if (algorithm == IsovistAlgorithm::RayCasting && numRays < 3) {
+        Rcpp::stop("Number of rays has to be >= 3 (" + std::to_string(numRays) + " provided)");
+    }
     if (pointCoords.rows() == 0) {
         Rcpp::stop("No data provided in point coordinates matrix");
     }
@@ -131,17 +163,59 @@ Rcpp::XPtr<ShapeMap> makeIsovists(Rcpp::XPtr<ShapeMap> boundsMap, Rcpp::NumericM
         Rcpp::stop("The number of field-of-view angles provided is not the "
                    "same as the number of points");
     }
-    std::unique_ptr<BSPNode> bspRoot(new BSPNode());
+}
 
+Rcpp::XPtr<ShapeMap> makeIsovistsFromTree(const BoundaryBSPTree &bspTree,
+                                          const Rcpp::NumericMatrix &pointCoords,
+                                          const Rcpp::NumericVector &directionAngles,
+                                          const Rcpp::NumericVector &fieldOfViewAngles,
+                                          bool progress, int nthreads,
+                                          IsovistAlgorithm algorithm, int numRays) {
     Rcpp::XPtr<ShapeMap> map(new ShapeMap("Isovists"));
-    if (makeBSPtree(getCommunicator(progress).get(), bspRoot.get(), *boundsMap)) {
-        for (int r = 0; r < pointCoords.rows(); ++r) {
-            Isovist iso;
-            auto coordRow = pointCoords.row(r);
-            Point2f p(coordRow[0], coordRow[1]);
+    bool rayCasting = algorithm == IsovistAlgorithm::RayCasting;
+    if (rayCasting ? bspTree.lines.empty() : !bspTree.built) {
+        return map;
+    }
+
+    // The R vectors are copied out, as they may not be read from threads
+    // other than the main one
+    size_t numPoints = pointCoords.rows();
+    std::vector<double> xs(pointCoords.column(0).begin(), pointCoords.column(0).end());
+    std::vector<double> ys(pointCoords.column(1).begin(), pointCoords.column(1).end());
+    std::vector<double> directions(directionAngles.begin(), directionAngles.end());
+    std::vector<double> fieldsOfView(fieldOfViewAngles.begin(), fieldOfViewAngles.end());
+    BSPNode *bspRoot = bspTree.root.get();
+    std::unique_ptr<IsovistRays::LineBuffer> lineBuffer;
+    if (rayCasting) {
+        lineBuffer = std::make_unique<IsovistRays::LineBuffer>(bspTree.lines);
+    }
+
+    auto comm = getCommunicator(progress);
+    if (comm) {
+        comm->CommPostMessage(Communicator::NUM_RECORDS, numPoints);
+    }
+
+    // The BSP tree (or the line buffer) is only read from here on and is
+    // shared by all threads. Every thread fills in the isovists it takes and
+    // the shapes are added to the map in the order of the points once all
+    // are done
+    std::vector<IsovistShape> isovists(numPoints);
+    const auto &colNames = getIsovistColumns(/* simple mode = */ false);
+    std::vector<std::vector<float>> columnValues(colNames.size(),
+                                                 std::vector<float>(numPoints, -1.0f));
+    nthreads = Parallel::getNumThreads(nthreads, numPoints);
+    std::atomic<size_t> nextPoint(0);
+    Parallel::forEachThread(nthreads, comm.get(), [&](int, Communicator *threadComm) {
+        std::vector<double> rayDistances;
+        for (size_t r = nextPoint++; r < numPoints; r = nextPoint++) {
+            threadComm->CommPostMessage(Communicator::CURRENT_RECORD, r);
+            if (threadComm->IsCancelled()) {
+                throw Communicator::CancelledException();
+            }
+            Point2f p(xs[r], ys[r]);
 
-            auto directionAngle = directionAngles[r];
-            auto fieldOfViewAngle = fieldOfViewAngles[r];
+            auto directionAngle = directions[r];
+            auto fieldOfViewAngle = fieldsOfView[r];
             double leftAngle = directionAngle - 0.5 * fieldOfViewAngle;
             if (leftAngle < 0) {
                 leftAngle += 2 * M_PI;
@@ -151,24 +225,132 @@ Rcpp::XPtr<ShapeMap> makeIsovists(Rcpp::XPtr<ShapeMap> boundsMap, Rcpp::NumericM
             if (rightAngle > 2 * M_PI) {
                 rightAngle -= 2 * M_PI;
             }
-            iso.makeit(bspRoot.get(), p, boundsMap->getRegion(), leftAngle, rightAngle);
 
-            std::vector<Point2f> polygon = iso.getPolygon();
-            if (polygon.size() < 3) {
+            auto &isovist = isovists[r];
+            isovist.origin = p;
+            if (rayCasting) {
+                auto rayIso = IsovistRays::makeIsovist(*lineBuffer, bspTree.region, p, leftAngle,
+                                                       rightAngle, numRays, rayDistances);
+                isovist.polygon = std::move(rayIso.polygon);
+                if (isovist.polygon.size() >= 3) {
+                    setIsovistData(rayIso, columnValues, r, /* simple mode = */ false);
+                }
+                continue;
+            }
+
+            Isovist iso;
+            iso.makeit(bspRoot, p, bspTree.region, leftAngle, rightAngle);
+            isovist.polygon = iso.getPolygon();
+            if (isovist.polygon.size() < 3) {
                 continue;
             }
             // if the polygon is not closed force it to close
-            if (polygon.front().x != polygon.back().x || polygon.front().y != polygon.back().y) {
-                polygon.push_back(polygon.front());
+            if (isovist.polygon.front().x != isovist.polygon.back().x ||
+                isovist.polygon.front().y != isovist.polygon.back().y) {
+                isovist.polygon.push_back(isovist.polygon.front());
             }
-            // false: closed polygon, true: isovist
-            int polyref = map->makePolyShape(polygon, false);
-            map->getAllShapes()[polyref].setCentroid(p);
+            setIsovistData(iso, columnValues, r, /* simple mode = */ false);
+        }
+    });
+
+    std::vector<int> polyrefs;
+    std::vector<size_t> pointIdxs;
+    for (size_t r = 0; r < numPoints; ++r) {
+        const auto &isovist = isovists[r];
+        if (isovist.polygon.size() < 3) {
+            continue;
+        }
+        // false: closed polygon, true: isovist
+        int polyref = map->makePolyShape(isovist.polygon, false);
+        map->getAllShapes()[polyref].setCentroid(isovist.origin);
+        polyrefs.push_back(polyref);
+        pointIdxs.push_back(r);
+    }
+    if (polyrefs.empty()) {
+        return map;
+    }
 
-            AttributeTable &table = map->getAttributeTable();
-            AttributeRow &row = table.getRow(AttributeKey(polyref));
-            setIsovistData(iso, table, row, /* simple mode = */ false);
+    // The columns and rows are looked up once, and the values are then
+    // written a column at a time
+    AttributeTable &table = map->getAttributeTable();
+    std::vector<int> cols;
+    for (const auto &colName : colNames) {
+        cols.push_back(table.getOrInsertColumn(colName));
+    }
+    std::vector<AttributeRow *> rows;
+    rows.reserve(polyrefs.size());
+    for (int polyref : polyrefs) {
+        rows.push_back(&table.getRow(AttributeKey(polyref)));
+    }
+    for (size_t c = 0; c < cols.size(); ++c) {
+        const auto &values = columnValues[c];
+        for (size_t i = 0; i < rows.size(); ++i) {
+            rows[i]->setValue(cols[c], values[pointIdxs[i]]);
         }
     }
     return map;
 }
+
+// [[Rcpp::export("Rcpp_makeIsovists")]]
+Rcpp::XPtr<ShapeMap> makeIsovists(Rcpp::XPtr<ShapeMap> boundsMap, Rcpp::NumericMatrix pointCoords,
+                                  Rcpp::NumericVector directionAngles,
+                                  Rcpp::NumericVector fieldOfViewAngles,
+                                  const Rcpp::Nullable<bool> progressNV = R_NilValue,
+                                  const Rcpp::Nullable<int> nthreadsNV = R_NilValue,
+                                  const Rcpp::Nullable<int> algorithmNV = R_NilValue,
+                                  const Rcpp::Nullable<int> numRaysNV = R_NilValue) {
+    auto progress = NullableValue::get(progressNV, false);
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+    auto algorithm = NullableValue::castIntGet(algorithmNV, IsovistAlgorithm::BSPTree);
+    auto numRays = NullableValue::get(numRaysNV, 1024);
+    prepareIsovistInputs(pointCoords, directionAngles, fieldOfViewAngles, nthreads, algorithm,
+                         numRays);
+
+    BoundaryBSPTree bspTree;
+    bspTree.region = boundsMap->getRegion();
+    bspTree.lines = getBoundaryLines(*boundsMap);
+    // the rays are cast against the lines directly, without a tree
+    if (algorithm == IsovistAlgorithm::BSPTree) {
+        bspTree.built =
+            makeBSPtree(getCommunicator(progress).get(), bspTree.root.get(), bspTree.lines);
+    }
+    return makeIsovistsFromTree(bspTree, pointCoords, directionAngles, fieldOfViewAngles,
+                                progress, nthreads, algorithm, numRays);
+}
+
+// [[Rcpp::export("Rcpp_makeBSPTree")]]
+Rcpp::List makeBSPTree(Rcpp::XPtr<ShapeMap> boundsMap,
+                       const Rcpp::Nullable<bool> progressNV = R_NilValue) {
+    auto progress = NullableValue::get(progressNV, false);
+
+    Rcpp::XPtr<BoundaryBSPTree> bspTree(new BoundaryBSPTree(), true);
+    bspTree->region = boundsMap->getRegion();
+    bspTree->lines = getBoundaryLines(*boundsMap);
+    bspTree->built =
+        makeBSPtree(getCommunicator(progress).get(), bspTree->root.get(), bspTree->lines);
+    // a map without lines gives no tree, while a tree with lines is only
+    // left unbuilt when making it was cancelled
+    return Rcpp::List::create(
+        Rcpp::Named("completed") = bspTree->built || bspTree->lines.empty(),
+        Rcpp::Named("bspTree") = bspTree);
+}
+
+// [[Rcpp::export("Rcpp_makeIsovistsFromBSPTree")]]
+Rcpp::XPtr<ShapeMap> makeIsovistsFromBSPTree(Rcpp::XPtr<BoundaryBSPTree> bspTree,
+                                             Rcpp::NumericMatrix pointCoords,
+                                             Rcpp::NumericVector directionAngles,
+                                             Rcpp::NumericVector fieldOfViewAngles,
+                                             const Rcpp::Nullable<bool> progressNV = R_NilValue,
+                                             const Rcpp::Nullable<int> nthreadsNV = R_NilValue,
+                                             const Rcpp::Nullable<int> algorithmNV = R_NilValue,
+                                             const Rcpp::Nullable<int> numRaysNV = R_NilValue) {
+    auto progress = NullableValue::get(progressNV, false);
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+    auto algorithm = NullableValue::castIntGet(algorithmNV, IsovistAlgorithm::BSPTree);
+    auto numRays = NullableValue::get(numRaysNV, 1024);
+    prepareIsovistInputs(pointCoords, directionAngles, fieldOfViewAngles, nthreads, algorithm,
+                         numRays);
+
+    return makeIsovistsFromTree(*bspTree, pointCoords, directionAngles, fieldOfViewAngles,
+                                progress, nthreads, algorithm, numRays);
+}
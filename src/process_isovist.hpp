@@ -0,0 +1,23 @@
+// SPDX-FileCopyrightText: 2025 Petros Koutsolampros
+//
+// SPDX-License-Identifier: GPL-3.0-only
+
+#pragma once
+
+#include "salalib/isovist.hpp"
+
+#include <memory>
+#include <vector>
+
+// A BSP tree of the lines of a boundary map along with the region of the map,
+// built once and handed to R, so that isovists against the same boundary do
+// not have to build it again
+struct BoundaryBSPTree {
+    std::unique_ptr<BSPNode> root = std::make_unique<BSPNode>();
+    Region4f region;
+    // the lines of the map, that the tree is made from and that rays are cast
+    // against when isovists are made by ray casting
+    std::vector<Line4f> lines;
+    // false if the tree was not made
+    bool built = false;
+};
@@ -7,8 +7,18 @@
 #include "salalib/gridproperties.hpp"
 
 #include "communicator.hpp"
+#include "engine_latticeBlocking.hpp"
+#include "engine_latticeFile.hpp"
+#include "engine_latticeGraph.hpp"
+#include "engine_latticeVisibility.hpp"
 #include "helper_nullablevalue.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+
+// [[Rcpp::plugins(openmp)]]
+
 RCPP_EXPOSED_CLASS(LatticeMap);
 
 // [[Rcpp::export("Rcpp_LatticeMap_createFromGrid")]]
@@ -37,8 +47,14 @@ Rcpp::XPtr<LatticeMap> createFromGrid(const double minX, const double minY, cons
 
 // [[Rcpp::export("Rcpp_LatticeMap_blockLines")]]
 Rcpp::List blockLines(Rcpp::XPtr<LatticeMap> latticeMapPtr, Rcpp::XPtr<ShapeMap> boundaryMapPtr,
-                      const Rcpp::Nullable<bool> copyMapNV = R_NilValue) {
+                      const Rcpp::Nullable<bool> copyMapNV = R_NilValue,
+                      const Rcpp::Nullable<int> nthreadsNV = R_NilValue) {
     auto copyMap = NullableValue::get(copyMapNV, true);
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
     if (copyMap) {
         auto prevLatticeMap = latticeMapPtr;
         const auto &prevRegion = prevLatticeMap->getRegion();
@@ -49,7 +65,11 @@ Rcpp::List blockLines(Rcpp::XPtr<LatticeMap> latticeMapPtr, Rcpp::XPtr<ShapeMap>
     for (auto line : boundaryMapPtr->getAllShapesAsLines()) {
         lines.emplace_back(line.start(), line.end());
     }
-    latticeMapPtr->blockLines(lines);
+    if (nthreads == 1) {
+        latticeMapPtr->blockLines(lines);
+    } else {
+        LatticeBlocking::blockLines(*latticeMapPtr, lines, nthreads);
+    }
 
     return Rcpp::List::create(Rcpp::Named("completed") = true,
                               Rcpp::Named("newAttributes") = std::vector<std::string>(),
@@ -83,9 +103,14 @@ Rcpp::List fill(Rcpp::XPtr<LatticeMap> latticeMapPtr, Rcpp::NumericMatrix pointC
         }
     }
 
+    // a seed that an earlier seed's flood already reached would only fill
+    // the same cells again, so it is skipped
     for (int r = 0; r < pointCoords.rows(); ++r) {
         auto coordRow = pointCoords.row(r);
         Point2f p(coordRow[0], coordRow[1]);
+        if (latticeMapPtr->getPoint(latticeMapPtr->pixelate(p)).filled()) {
+            continue;
+        }
         latticeMapPtr->makePoints(p, 0, getCommunicator(progress).get());
     }
 
@@ -98,9 +123,15 @@ Rcpp::List fill(Rcpp::XPtr<LatticeMap> latticeMapPtr, Rcpp::NumericMatrix pointC
 // [[Rcpp::export("Rcpp_LatticeMap_makeGraph")]]
 Rcpp::List makeGraph(Rcpp::XPtr<LatticeMap> latticeMapPtr, const bool boundaryGraph,
                      const double maxVisibility, const Rcpp::Nullable<bool> copyMapNV = R_NilValue,
-                     const Rcpp::Nullable<bool> progressNV = R_NilValue) {
+                     const Rcpp::Nullable<bool> progressNV = R_NilValue,
+                     const Rcpp::Nullable<int> nthreadsNV = R_NilValue) {
     auto copyMap = NullableValue::get(copyMapNV, true);
     auto progress = NullableValue::get(progressNV, false);
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
     if (copyMap) {
         auto prevLatticeMap = latticeMapPtr;
         const auto &prevRegion = prevLatticeMap->getRegion();
@@ -109,7 +140,13 @@ Rcpp::List makeGraph(Rcpp::XPtr<LatticeMap> latticeMapPtr, const bool boundaryGr
     }
     auto prevAttributes = getLatticeMapAttributeNames(latticeMapPtr);
     try {
-        latticeMapPtr->sparkGraph2(getCommunicator(progress).get(), boundaryGraph, maxVisibility);
+        if (nthreads == 1) {
+            latticeMapPtr->sparkGraph2(getCommunicator(progress).get(), boundaryGraph,
+                                       maxVisibility);
+        } else {
+            LatticeVisibility::makeGraph(getCommunicator(progress).get(), *latticeMapPtr,
+                                         boundaryGraph, maxVisibility, nthreads);
+        }
     } catch (Communicator::CancelledException &) {
         return Rcpp::List::create(Rcpp::Named("completed") = false);
     }
@@ -151,6 +188,64 @@ Rcpp::List unmakeGraph(Rcpp::XPtr<LatticeMap> latticeMapPtr, bool removeLinksWhe
                               Rcpp::Named("mapPtr") = latticeMapPtr);
 }
 
+// [[Rcpp::export("Rcpp_LatticeMap_compressGraph")]]
+Rcpp::List compressGraph(Rcpp::XPtr<LatticeMap> latticeMapPtr,
+                         const Rcpp::Nullable<bool> copyMapNV = R_NilValue,
+                         const Rcpp::Nullable<bool> progressNV = R_NilValue,
+                         const Rcpp::Nullable<int> nthreadsNV = R_NilValue) {
+    auto copyMap = NullableValue::get(copyMapNV, true);
+    auto progress = NullableValue::get(progressNV, false);
+    auto nthreads = NullableValue::get(nthreadsNV, 1);
+    if (nthreads < 0) {
+        Rcpp::stop("Number of threads has to be >= 1 or 0 for all (" + std::to_string(nthreads) +
+                   " provided)");
+    }
+    if (!latticeMapPtr->isProcessed()) {
+        Rcpp::stop("Current map has not had its graph made so there's nothing to compress");
+    }
+    if (copyMap) {
+        auto prevLatticeMap = latticeMapPtr;
+        const auto &prevRegion = prevLatticeMap->getRegion();
+        latticeMapPtr = Rcpp::XPtr(new LatticeMap(prevRegion));
+        latticeMapPtr->copy(*prevLatticeMap, true, true);
+    }
+
+    std::unique_ptr<LatticeGraph::CompressedGraph> graph;
+    try {
+        graph = std::make_unique<LatticeGraph::CompressedGraph>(getCommunicator(progress).get(),
+                                                                *latticeMapPtr, nthreads);
+    } catch (Communicator::CancelledException &) {
+        return Rcpp::List::create(Rcpp::Named("completed") = false);
+    }
+    // the nodes are only released once they are all encoded, and the links
+    // are kept as the compressed graph does not hold them
+    latticeMapPtr->unmake(false);
+
+    return Rcpp::List::create(Rcpp::Named("completed") = true,
+                              Rcpp::Named("newAttributes") = std::vector<std::string>{},
+                              Rcpp::Named("newProperties") = std::vector<std::string>{},
+                              Rcpp::Named("mapPtr") = latticeMapPtr,
+                              // release the unique_ptr so that it's not deleted on scope close
+                              Rcpp::Named("graphPtr") =
+                                  Rcpp::XPtr<LatticeGraph::CompressedGraph>(graph.release()));
+}
+
+// [[Rcpp::export("Rcpp_LatticeMap_write")]]
+void latticeMapWrite(Rcpp::XPtr<LatticeMap> latticeMapPtr,
+                     Rcpp::XPtr<LatticeGraph::CompressedGraph> graphPtr, std::string fileName) {
+    LatticeFile::write(fileName, *latticeMapPtr, *graphPtr);
+}
+
+// [[Rcpp::export("Rcpp_LatticeMap_read")]]
+Rcpp::List latticeMapRead(std::string fileName) {
+    auto contents = LatticeFile::read(fileName);
+    // release the unique_ptrs so that they are not deleted on scope close
+    return Rcpp::List::create(Rcpp::Named("mapPtr") =
+                                  Rcpp::XPtr<LatticeMap>(contents.latticeMap.release()),
+                              Rcpp::Named("graphPtr") = Rcpp::XPtr<LatticeGraph::CompressedGraph>(
+                                  contents.graph.release()));
+}
+
 // [[Rcpp::export("Rcpp_LatticeMap_getName")]]
 std::string latticeMapGetName(Rcpp::XPtr<LatticeMap> latticeMapPtr) {
     return latticeMapPtr->getName();
@@ -171,44 +266,118 @@ Rcpp::IntegerMatrix latticeMapGetLinks(Rcpp::XPtr<LatticeMap> latticeMapPtr) {
     return linkData;
 }
 
-// [[Rcpp::export("Rcpp_LatticeMap_getConnections")]]
-Rcpp::IntegerMatrix latticeMapGetConnections(Rcpp::XPtr<LatticeMap> latticeMapPtr) {
-    auto &points = latticeMapPtr->getPoints();
-    int numConnections = 0;
-    for (size_t i = 0; i < points.columns(); i++) {
-        for (size_t j = 0; j < points.rows(); j++) {
-            Point &pnt = points(static_cast<size_t>(j), static_cast<size_t>(i));
-            if (pnt.filled() && pnt.hasNode()) {
-                PixelRef pix(i, j);
-                PixelRefVector connections;
-                pnt.getNode().contents(connections);
-                numConnections += connections.size();
+namespace {
+    // Calls func(cell, hood) for each cell with a node, with the cells it is
+    // connected to. The cells are visited column by column and the nodes are
+    // all read into the same vector
+    template <typename Func> void forEachConnectedCell(LatticeMap &latticeMap, Func func) {
+        auto &points = latticeMap.getPoints();
+        PixelRefVector hood;
+        for (size_t i = 0; i < points.columns(); i++) {
+            for (size_t j = 0; j < points.rows(); j++) {
+                Point &pnt = points(static_cast<size_t>(j), static_cast<size_t>(i));
+                if (pnt.filled() && pnt.hasNode()) {
+                    hood.clear();
+                    pnt.getNode().contents(hood);
+                    func(PixelRef(i, j), hood);
+                }
             }
         }
     }
+} // namespace
+
+// [[Rcpp::export("Rcpp_LatticeMap_getConnections")]]
+Rcpp::IntegerMatrix latticeMapGetConnections(Rcpp::XPtr<LatticeMap> latticeMapPtr) {
+    int numConnections = 0;
+    forEachConnectedCell(*latticeMapPtr, [&](PixelRef, const PixelRefVector &hood) {
+        numConnections += hood.size();
+    });
 
     Rcpp::IntegerMatrix connectionData(numConnections, 2L);
     Rcpp::colnames(connectionData) = Rcpp::CharacterVector({"from", "to"});
     int rowIdx = 0;
-    for (size_t i = 0; i < points.columns(); i++) {
-        for (size_t j = 0; j < points.rows(); j++) {
-            Point &pnt = points(static_cast<size_t>(j), static_cast<size_t>(i));
-            if (pnt.filled() && pnt.hasNode()) {
-                PixelRef pix(i, j);
-                PixelRefVector hood;
-                pnt.getNode().contents(hood);
-                for (PixelRef &p : hood) {
-                    const Rcpp::IntegerMatrix::Row &row = connectionData(rowIdx, Rcpp::_);
-                    row[0] = pix;
-                    row[1] = p;
-                    rowIdx++;
-                }
-            }
+    forEachConnectedCell(*latticeMapPtr, [&](PixelRef pix, const PixelRefVector &hood) {
+        for (const PixelRef &p : hood) {
+            connectionData(rowIdx, 0) = pix;
+            connectionData(rowIdx, 1) = p;
+            rowIdx++;
         }
-    }
+    });
     return connectionData;
 }
 
+// [[Rcpp::export("Rcpp_LatticeMap_getConnectionsCSR")]]
+Rcpp::List latticeMapGetConnectionsCSR(Rcpp::XPtr<LatticeMap> latticeMapPtr) {
+    // The connections of refs[i] are targets[offsets[i] + 1] to
+    // targets[offsets[i + 1]]. The offsets are doubles to allow for more
+    // connections than fit in an R integer
+    R_xlen_t numRefs = 0;
+    R_xlen_t numTargets = 0;
+    forEachConnectedCell(*latticeMapPtr, [&](PixelRef, const PixelRefVector &hood) {
+        numRefs++;
+        numTargets += hood.size();
+    });
+
+    Rcpp::IntegerVector refs(numRefs);
+    Rcpp::NumericVector offsets(numRefs + 1);
+    Rcpp::IntegerVector targets(numTargets);
+    R_xlen_t refIdx = 0;
+    R_xlen_t targetIdx = 0;
+    offsets[0] = 0.0;
+    forEachConnectedCell(*latticeMapPtr, [&](PixelRef pix, const PixelRefVector &hood) {
+        refs[refIdx] = pix;
+        for (const PixelRef &p : hood) {
+            targets[targetIdx] = p;
+            targetIdx++;
+        }
+        refIdx++;
+        offsets[refIdx] = static_cast<double>(targetIdx);
+    });
+    return Rcpp::List::create(Rcpp::Named("refs") = refs, Rcpp::Named("offsets") = offsets,
+                              Rcpp::Named("targets") = targets);
+}
+
+// [[Rcpp::export("Rcpp_LatticeMap_writeConnections")]]
+double latticeMapWriteConnections(Rcpp::XPtr<LatticeMap> latticeMapPtr, std::string filePath,
+                                  const Rcpp::Nullable<int> chunkSizeNV = R_NilValue) {
+    auto chunkSize = NullableValue::get(chunkSizeNV, 1 << 20);
+    if (chunkSize < 1) {
+        Rcpp::stop("Chunk size has to be >= 1 (" + std::to_string(chunkSize) + " provided)");
+    }
+
+    // The connections are written as pairs of 32-bit integers (from, to) in
+    // the byte order of the machine, chunkSize pairs at a time, so that only
+    // one chunk is ever held in memory
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        Rcpp::stop("Could not open file " + filePath + " for writing");
+    }
+    const size_t chunkLength = 2 * static_cast<size_t>(chunkSize);
+    std::vector<int32_t> chunk;
+    chunk.reserve(chunkLength);
+    double numConnections = 0;
+    auto writeChunk = [&file, &chunk, &filePath]() {
+        file.write(reinterpret_cast<const char *>(chunk.data()),
+                   static_cast<std::streamsize>(chunk.size() * sizeof(int32_t)));
+        if (!file) {
+            Rcpp::stop("Could not write to file " + filePath);
+        }
+        chunk.clear();
+    };
+    forEachConnectedCell(*latticeMapPtr, [&](PixelRef pix, const PixelRefVector &hood) {
+        for (const PixelRef &p : hood) {
+            chunk.push_back(static_cast<int32_t>(pix));
+            chunk.push_back(static_cast<int32_t>(p));
+            if (chunk.size() == chunkLength) {
+                writeChunk();
+            }
+        }
+        numConnections += static_cast<double>(hood.size());
+    });
+    writeChunk();
+    return numConnections;
+}
+
 // [[Rcpp::export("Rcpp_LatticeMap_getGridCoordinates")]]
 Rcpp::NumericMatrix getGridCoordinates(Rcpp::XPtr<LatticeMap> latticeMapPtr) {
     Rcpp::NumericMatrix coords(latticeMapPtr->getRows() * latticeMapPtr->getCols(), 3);
@@ -251,43 +420,46 @@ std::vector<std::string> getLatticeMapAttributeNames(Rcpp::XPtr<LatticeMap> latt
 }
 
 // [[Rcpp::export("Rcpp_LatticeMap_getAttributeData")]]
-std::map<std::string, std::vector<double>>
-getLatticeMapAttributeData(Rcpp::XPtr<LatticeMap> latticeMap,
-                           std::vector<std::string> attributeNames) {
+Rcpp::List getLatticeMapAttributeData(Rcpp::XPtr<LatticeMap> latticeMap,
+                                      std::vector<std::string> attributeNames) {
     auto &attrbs = latticeMap->getAttributeTable();
-    std::map<std::string, std::vector<double>> data;
-    for (auto &attributeName : attributeNames) {
-        auto &attributeData = data[attributeName];
-        attributeData.reserve(latticeMap->getRows() * latticeMap->getCols());
-        if (attributeName == attrbs.getColumnName(size_t(-1))) {
-            for (size_t i = 0; i < latticeMap->getRows(); i++) {
-                for (size_t j = 0; j < latticeMap->getCols(); j++) {
-                    PixelRef ref(j, i);
-                    const auto &point = latticeMap->getPoint(ref);
-                    if (point.filled()) {
-                        attributeData.push_back(ref);
-                    } else {
-                        attributeData.push_back(nan(""));
-                    }
-                }
-            }
-        } else {
-            size_t colIdx = attrbs.getColumnIndex(attributeName);
-
-            for (size_t i = 0; i < latticeMap->getRows(); i++) {
-                for (size_t j = 0; j < latticeMap->getCols(); j++) {
-                    PixelRef ref(j, i);
-                    const auto &point = latticeMap->getPoint(ref);
-                    if (point.filled()) {
-                        const auto &row = latticeMap->getAttributeTable().getRow(AttributeKey(ref));
-                        attributeData.push_back(row.getValue(colIdx));
-                    } else {
-                        attributeData.push_back(nan(""));
-                    }
-                }
-            }
+
+    // the columns are given sorted by name and without duplicates
+    std::sort(attributeNames.begin(), attributeNames.end());
+    attributeNames.erase(std::unique(attributeNames.begin(), attributeNames.end()),
+                         attributeNames.end());
+
+    // The R columns (one value per cell of the grid, row by row) are
+    // allocated once with NA for the cells that are not filled, and the
+    // filled ones (the rows of the table) written in a single pass over the
+    // table. -1 stands for the key column
+    const size_t numCols = latticeMap->getCols();
+    const size_t numCells = latticeMap->getRows() * numCols;
+    const std::string &keyColumnName = attrbs.getColumnName(size_t(-1));
+    Rcpp::List data(attributeNames.size());
+    std::vector<int> colIdxs;
+    std::vector<double *> columns;
+    colIdxs.reserve(attributeNames.size());
+    columns.reserve(attributeNames.size());
+    for (size_t i = 0; i < attributeNames.size(); ++i) {
+        const auto &attributeName = attributeNames[i];
+        colIdxs.push_back(attributeName == keyColumnName
+                              ? -1
+                              : static_cast<int>(attrbs.getColumnIndex(attributeName)));
+        Rcpp::NumericVector column(numCells, NA_REAL);
+        columns.push_back(column.begin());
+        data[i] = column;
+    }
+    for (auto rowIt = attrbs.begin(); rowIt != attrbs.end(); ++rowIt) {
+        PixelRef ref(rowIt->getKey().value);
+        size_t cellIdx = static_cast<size_t>(ref.y) * numCols + static_cast<size_t>(ref.x);
+        const auto &row = rowIt->getRow();
+        for (size_t i = 0; i < columns.size(); ++i) {
+            columns[i][cellIdx] = colIdxs[i] == -1 ? static_cast<double>(rowIt->getKey().value)
+                                                   : static_cast<double>(row.getValue(colIdxs[i]));
         }
     }
+    data.names() = Rcpp::wrap(attributeNames);
     return data;
 }
 
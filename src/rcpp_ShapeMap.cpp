@@ -6,6 +6,8 @@
 
 #include <Rcpp.h>
 
+#include <algorithm>
+
 RCPP_EXPOSED_CLASS(ShapeMap);
 
 // [[Rcpp::export("Rcpp_ShapeMap_make")]]
@@ -35,24 +37,42 @@ std::vector<std::string> getShapeMapAttributeNames(Rcpp::XPtr<ShapeMap> shapeMap
 }
 
 // [[Rcpp::export("Rcpp_ShapeMap_getAttributeData")]]
-std::map<std::string, std::vector<double>>
-getShapeMapAttributeData(Rcpp::XPtr<ShapeMap> shapeMap, std::vector<std::string> attributeNames) {
+Rcpp::List getShapeMapAttributeData(Rcpp::XPtr<ShapeMap> shapeMap,
+                                    std::vector<std::string> attributeNames) {
     auto &attrbs = shapeMap->getAttributeTable();
-    std::map<std::string, std::vector<double>> data;
-    for (auto &attributeName : attributeNames) {
-        auto &attributeData = data[attributeName];
-        attributeData.reserve(attrbs.getNumRows());
-        if (attributeName == attrbs.getColumnName(size_t(-1))) {
-            for (auto rowIt = attrbs.begin(); rowIt != attrbs.end(); ++rowIt) {
-                attributeData.push_back(rowIt->getKey().value);
-            }
-        } else {
-            size_t colIdx = attrbs.getColumnIndex(attributeName);
-            for (auto rowIt = attrbs.begin(); rowIt != attrbs.end(); ++rowIt) {
-                attributeData.push_back(rowIt->getRow().getValue(colIdx));
-            }
+
+    // the columns are given sorted by name and without duplicates
+    std::sort(attributeNames.begin(), attributeNames.end());
+    attributeNames.erase(std::unique(attributeNames.begin(), attributeNames.end()),
+                         attributeNames.end());
+
+    // The R columns are allocated once and filled in a single pass over
+    // the rows of the table. -1 stands for the key column
+    const size_t numRows = attrbs.getNumRows();
+    const std::string &keyColumnName = attrbs.getColumnName(size_t(-1));
+    Rcpp::List data(attributeNames.size());
+    std::vector<int> colIdxs;
+    std::vector<double *> columns;
+    colIdxs.reserve(attributeNames.size());
+    columns.reserve(attributeNames.size());
+    for (size_t i = 0; i < attributeNames.size(); ++i) {
+        const auto &attributeName = attributeNames[i];
+        colIdxs.push_back(attributeName == keyColumnName
+                              ? -1
+                              : static_cast<int>(attrbs.getColumnIndex(attributeName)));
+        Rcpp::NumericVector column(numRows);
+        columns.push_back(column.begin());
+        data[i] = column;
+    }
+    size_t rowIdx = 0;
+    for (auto rowIt = attrbs.begin(); rowIt != attrbs.end(); ++rowIt, ++rowIdx) {
+        const auto &row = rowIt->getRow();
+        for (size_t i = 0; i < columns.size(); ++i) {
+            columns[i][rowIdx] = colIdxs[i] == -1 ? static_cast<double>(rowIt->getKey().value)
+                                                  : static_cast<double>(row.getValue(colIdxs[i]));
         }
     }
+    data.names() = Rcpp::wrap(attributeNames);
     return data;
 }
 
@@ -74,63 +94,69 @@ Rcpp::NumericMatrix getShapesAsLineCoords(Rcpp::XPtr<ShapeMap> shapeMap) {
     return coords;
 }
 
-// [[Rcpp::export("Rcpp_ShapeMap_getShapesAsPolygonCoords")]]
-Rcpp::GenericVector getShapesAsPolygonCoords(Rcpp::XPtr<ShapeMap> shapeMap) {
-    float TOLERANCE = 0.0001;
-    std::vector<std::string> names;
-    Rcpp::GenericVector coords;
-    const auto &shapes = shapeMap->getAllShapes();
-
-    for (const auto &shape : shapes) {
-        if (!shape.second.isPolygon())
-            continue;
-        const auto &firstPoint = *shape.second.points.begin();
-        const auto &lastPoint = *shape.second.points.rbegin();
-        bool lastPointIsFirst = fabs(firstPoint.x - lastPoint.x) < TOLERANCE &&
-                                fabs(firstPoint.y - lastPoint.y) < TOLERANCE;
-        Rcpp::NumericMatrix poly(shape.second.points.size() + (lastPointIsFirst ? 0 : 1), 2);
-        Rcpp::colnames(poly) = Rcpp::CharacterVector({"x", "y"});
+namespace {
+    // A coordinate matrix (x, y) of the points of a shape, written straight
+    // into the memory of the R matrix, optionally closing it with the first
+    // point
+    Rcpp::NumericMatrix makeCoordMatrix(const std::vector<Point2f> &points, bool close) {
+        const int numRows = static_cast<int>(points.size()) + (close ? 1 : 0);
+        Rcpp::NumericMatrix coords(numRows, 2);
+        Rcpp::colnames(coords) = Rcpp::CharacterVector({"x", "y"});
+        double *xs = coords.begin();
+        double *ys = xs + numRows;
         int rowIdx = 0;
-        for (const auto &point : shape.second.points) {
-            const Rcpp::NumericMatrix::Row &row = poly(rowIdx, Rcpp::_);
-            row[0] = point.x;
-            row[1] = point.y;
+        for (const auto &point : points) {
+            xs[rowIdx] = point.x;
+            ys[rowIdx] = point.y;
             rowIdx++;
         }
-        if (!lastPointIsFirst) {
-            const Rcpp::NumericMatrix::Row &row = poly(rowIdx, Rcpp::_);
-            row[0] = firstPoint.x;
-            row[1] = firstPoint.y;
+        if (close) {
+            xs[rowIdx] = points.front().x;
+            ys[rowIdx] = points.front().y;
         }
-        coords.push_back(poly);
+        return coords;
     }
-    return coords;
+
+    // The shapes are counted first, so that the list is allocated once
+    template <class Pred, class Make>
+    Rcpp::List getShapesAsCoords(ShapeMap &shapeMap, Pred &&isIncluded, Make &&makeCoords) {
+        const auto &shapes = shapeMap.getAllShapes();
+        size_t numShapes = 0;
+        for (const auto &shape : shapes) {
+            if (isIncluded(shape.second)) {
+                numShapes++;
+            }
+        }
+        Rcpp::List coords(numShapes);
+        size_t shapeIdx = 0;
+        for (const auto &shape : shapes) {
+            if (isIncluded(shape.second)) {
+                coords[shapeIdx++] = makeCoords(shape.second);
+            }
+        }
+        return coords;
+    }
+} // namespace
+
+// [[Rcpp::export("Rcpp_ShapeMap_getShapesAsPolygonCoords")]]
+Rcpp::GenericVector getShapesAsPolygonCoords(Rcpp::XPtr<ShapeMap> shapeMap) {
+    float TOLERANCE = 0.0001;
+    return getShapesAsCoords(
+        *shapeMap, [](const SalaShape &shape) { return shape.isPolygon(); },
+        [TOLERANCE](const SalaShape &shape) {
+            const auto &firstPoint = *shape.points.begin();
+            const auto &lastPoint = *shape.points.rbegin();
+            bool lastPointIsFirst = fabs(firstPoint.x - lastPoint.x) < TOLERANCE &&
+                                    fabs(firstPoint.y - lastPoint.y) < TOLERANCE;
+            return makeCoordMatrix(shape.points, !lastPointIsFirst);
+        });
 }
 
 // [[Rcpp::export("Rcpp_ShapeMap_getShapesAsPolylineCoords")]]
 Rcpp::GenericVector getShapesAsPolylineCoords(Rcpp::XPtr<ShapeMap> shapeMap) {
-    // float TOLERANCE = 0.0001;
-    std::vector<std::string> names;
-    Rcpp::GenericVector coords;
-    const auto &shapes = shapeMap->getAllShapes();
-
-    for (const auto &shape : shapes) {
-        if (!shape.second.isPolyLine())
-            continue;
-        // const auto &firstPoint = *shape.second.points.begin();
-        // const auto &lastPoint = *shape.second.points.rbegin();
-        Rcpp::NumericMatrix poly(shape.second.points.size(), 2);
-        Rcpp::colnames(poly) = Rcpp::CharacterVector({"x", "y"});
-        int rowIdx = 0;
-        for (const auto &point : shape.second.points) {
-            const Rcpp::NumericMatrix::Row &row = poly(rowIdx, Rcpp::_);
-            row[0] = point.x;
-            row[1] = point.y;
-            rowIdx++;
-        }
-        coords.push_back(poly);
-    }
-    return coords;
+    return getShapesAsCoords(
+        *shapeMap, [](const SalaShape &shape) { return shape.isPolyLine(); },
+        [](const SalaShape &shape) { return makeCoordMatrix(shape.points, false); });
 }
 
 // [[Rcpp::export("Rcpp_ShapeMap_getShapeCoords")]]